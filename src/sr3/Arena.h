@@ -0,0 +1,89 @@
+#ifndef SR3_ARENA_H
+#define SR3_ARENA_H
+
+#include <vector>
+#include <new>
+#include <utility>
+#include <cassert>
+
+// Storage of objects in fixed size blocks. Objects never move, so
+// pointers to them stay valid until they are erased, and iterating by
+// index walks each block contiguously. The slots of erased objects are
+// reused by the next emplace(), last erased first.
+template<typename T, unsigned int BlockSize = 64>
+class Arena {
+	public:
+		Arena() = default;
+		~Arena() { clear(); }
+		Arena(const Arena&) = delete;
+		Arena(const Arena&&) = delete;
+		Arena& operator=(const Arena&) & = delete;
+		Arena& operator=(Arena&&) & = delete;
+
+		// Constructs a new object and returns its index. The slot is only
+		// taken once the object is constructed, so a throwing constructor
+		// leaves the arena as it was.
+		template<typename... Args>
+		unsigned int emplace(Args&&... args)
+		{
+			unsigned int i = mFree.empty() ? mSize : mFree.back();
+			if(i == mSize) {
+				if(i == mBlocks.size() * BlockSize) {
+					auto b = static_cast<T*>(::operator new(sizeof(T) * BlockSize));
+					try {
+						mBlocks.push_back(b);
+					} catch(...) {
+						::operator delete(b);
+						throw;
+					}
+				}
+				if(mLive.size() == mSize)
+					mLive.push_back(0);
+			}
+			new(&mBlocks[i / BlockSize][i % BlockSize]) T(std::forward<Args>(args)...);
+			if(i == mSize)
+				mSize++;
+			else
+				mFree.pop_back();
+			mLive[i] = 1;
+			return i;
+		}
+
+		void erase(unsigned int i)
+		{
+			assert(contains(i));
+			(*this)[i].~T();
+			mLive[i] = 0;
+			mFree.push_back(i);
+		}
+
+		bool contains(unsigned int i) const { return i < mSize && mLive[i]; }
+		T& operator[](unsigned int i) { assert(contains(i)); return mBlocks[i / BlockSize][i % BlockSize]; }
+		const T& operator[](unsigned int i) const { assert(contains(i)); return mBlocks[i / BlockSize][i % BlockSize]; }
+		// number of slots, live or erased
+		unsigned int size() const { return mSize; }
+
+		// destroys all objects and frees the blocks
+		void clear()
+		{
+			for(unsigned int i = mSize; i-- > 0; ) {
+				if(mLive[i])
+					(*this)[i].~T();
+			}
+			mSize = 0;
+			for(auto b : mBlocks)
+				::operator delete(b);
+			mBlocks.clear();
+			mLive.clear();
+			mFree.clear();
+		}
+
+	private:
+		std::vector<T*> mBlocks;
+		std::vector<unsigned char> mLive;
+		std::vector<unsigned int> mFree;
+		unsigned int mSize = 0;
+};
+
+#endif
+
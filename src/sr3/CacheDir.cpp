@@ -0,0 +1,41 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+
+#include <sys/stat.h>
+
+#include "CacheDir.h"
+
+namespace {
+	bool makeDir(const std::string& path)
+	{
+		if(mkdir(path.c_str(), 0700) == 0 || errno == EEXIST)
+			return true;
+		perror(("Cache directory: " + path).c_str());
+		return false;
+	}
+
+	std::string findCacheDir()
+	{
+		std::string base;
+		auto xdg = getenv("XDG_CACHE_HOME");
+		if(xdg && xdg[0] == '/') {
+			base = xdg;
+		} else {
+			auto home = getenv("HOME");
+			if(!home || !home[0])
+				return std::string();
+			base = std::string(home) + "/.cache";
+		}
+		auto dir = base + "/starrover3";
+		if(!makeDir(base) || !makeDir(dir))
+			return std::string();
+		return dir + "/";
+	}
+}
+
+const std::string& getCacheDir()
+{
+	static const std::string Dir = findCacheDir();
+	return Dir;
+}
@@ -0,0 +1,12 @@
+#ifndef SR3_CACHEDIR_H
+#define SR3_CACHEDIR_H
+
+#include <string>
+
+// Returns the per-user cache directory of the game, creating it if needed:
+// $XDG_CACHE_HOME/starrover3, or ~/.cache/starrover3 if that is not set.
+// The path ends with '/'. Returns an empty string if no directory could
+// be made, in which case nothing should be cached.
+const std::string& getCacheDir();
+
+#endif
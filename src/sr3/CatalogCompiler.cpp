@@ -0,0 +1,103 @@
+// catalogc: compiles a product catalog text file into a header with
+// constexpr tables for the SR3_STATIC_CATALOG build.
+//
+// usage: catalogc <products.txt> <StaticCatalog.h>
+
+#include <cstdio>
+#include <algorithm>
+
+#include "CatalogFile.h"
+
+namespace {
+	// 9 significant digits restore the exact float
+	std::string floatLiteral(float v)
+	{
+		char buf[32];
+		snprintf(buf, sizeof(buf), "%.9g", v);
+		std::string ret = buf;
+		if(ret.find_first_of(".e") == std::string::npos)
+			ret += ".0";
+		return ret + "f";
+	}
+
+	void writeFloats(FILE* f, const char* name, const std::vector<float>& v)
+	{
+		fprintf(f, "\tconstexpr float %s[] = {", name);
+		for(size_t i = 0; i < v.size(); i++)
+			fprintf(f, "%s%s,", i % NumSOTypes ? " " : "\n\t\t", floatLiteral(v[i]).c_str());
+		fprintf(f, "\n\t};\n");
+	}
+
+	std::string quote(const std::string& s)
+	{
+		std::string ret = "\"";
+		for(char c : s) {
+			if(c == '"' || c == '\\')
+				ret.push_back('\\');
+			ret.push_back(c);
+		}
+		ret.push_back('"');
+		return ret;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if(argc != 3) {
+		fprintf(stderr, "usage: %s <products.txt> <StaticCatalog.h>\n", argv[0]);
+		return 1;
+	}
+
+	CatalogDefinition def;
+	std::string error;
+	if(!parseCatalogFile(argv[1], def, error) || !validateCatalog(def, error)) {
+		fprintf(stderr, "%s\n", error.c_str());
+		return 1;
+	}
+	CompiledCatalog c;
+	compileCatalog(def, c);
+
+	unsigned int maxRecipe = 0;
+	for(size_t i = 0; i + 1 < c.RecipeStart.size(); i++)
+		maxRecipe = std::max(maxRecipe, c.RecipeStart[i + 1] - c.RecipeStart[i]);
+
+	FILE* f = fopen(argv[2], "w");
+	if(!f) {
+		perror(argv[2]);
+		return 1;
+	}
+	fprintf(f, "// Generated by catalogc from %s. Do not edit.\n\n", argv[1]);
+	fprintf(f, "namespace StaticCatalog {\n");
+	fprintf(f, "\tconstexpr unsigned int NumProducts = %zu;\n", c.Names.size());
+	fprintf(f, "\tconstexpr unsigned int Staple = %u;\n", c.Staple);
+	fprintf(f, "\tconstexpr unsigned int MaxRecipeSize = %u;\n\n", maxRecipe);
+
+	fprintf(f, "\tconstexpr const char* Names[] = {");
+	for(const auto& name : c.Names)
+		fprintf(f, "\n\t\t%s,", quote(name).c_str());
+	fprintf(f, "\n\t};\n\n");
+
+	writeFloats(f, "Consumption", c.Consumption);
+	writeFloats(f, "ProductionCap", c.ProductionCap);
+	writeFloats(f, "AreaFactor", c.AreaFactor);
+
+	fprintf(f, "\n\tconstexpr unsigned int RecipeStart[] = {");
+	for(size_t i = 0; i < c.RecipeStart.size(); i++)
+		fprintf(f, "%s%u,", i % NumSOTypes ? " " : "\n\t\t", c.RecipeStart[i]);
+	fprintf(f, "\n\t};\n\n");
+
+	// never empty, an array must have at least one element
+	fprintf(f, "\tconstexpr RecipeInput RecipeInputs[] = {");
+	for(const auto& in : c.RecipeInputs)
+		fprintf(f, "\n\t\t{ %u, %s },", in.Good, floatLiteral(in.Quantity).c_str());
+	if(c.RecipeInputs.empty())
+		fprintf(f, "\n\t\t{ 0, 0.0f },");
+	fprintf(f, "\n\t};\n");
+	fprintf(f, "}\n");
+
+	if(fclose(f) != 0) {
+		perror(argv[2]);
+		return 1;
+	}
+	return 0;
+}
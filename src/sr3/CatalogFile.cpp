@@ -0,0 +1,375 @@
+#include <cctype>
+#include <cstdlib>
+#include <cmath>
+#include <fstream>
+#include <algorithm>
+
+#include "CatalogFile.h"
+
+ProductParameter::ProductParameter(float value)
+	: mBaseValue(value)
+{
+}
+
+float ProductParameter::getValue(SOType t) const
+{
+	auto it = mOverrideValue.find(t);
+	if(it == mOverrideValue.end())
+		return mBaseValue;
+	else
+		return it->second;
+}
+
+void ProductParameter::setOverrideValue(SOType t, float value)
+{
+	mOverrideValue[t] = value;
+}
+
+
+Product::Product(const std::string& name, float consumption, float labourreq, float areafactor, float productioncap)
+	: mName(name)
+{
+	mParameters.insert({"consumption", ProductParameter(consumption)});
+	mParameters.insert({"productionCap", ProductParameter(productioncap)});
+	mParameters.insert({"areaFactor", ProductParameter(areafactor)});
+
+	mGoodsRequired.insert({"Labour", ProductParameter(labourreq)});
+}
+
+const std::string& Product::getName() const
+{
+	return mName;
+}
+
+float Product::getParameter(const std::string& name, SOType t) const
+{
+	return mParameters.at(name).getValue(t);
+}
+
+void Product::setOverrideValue(const std::string& name, SOType t, float value)
+{
+	mParameters.at(name).setOverrideValue(t, value);
+}
+
+void Product::setGoodRequirement(const std::string& name, float value)
+{
+	mGoodsRequired.insert({name, value});
+}
+
+void Product::setGoodRequirementOverride(const std::string& name, SOType t, float value)
+{
+	mGoodsRequired.at(name).setOverrideValue(t, value);
+}
+
+bool Product::hasParameter(const std::string& name) const
+{
+	return mParameters.find(name) != mParameters.end();
+}
+
+bool Product::hasGoodRequirement(const std::string& name) const
+{
+	return mGoodsRequired.find(name) != mGoodsRequired.end();
+}
+
+std::vector<std::string> Product::getRequiredGoods() const
+{
+	std::vector<std::string> ret;
+	for(auto it : mGoodsRequired)
+		ret.push_back(it.first);
+	return ret;
+}
+
+float Product::getRequiredGoodQuantity(const std::string& reqGood, SOType t) const
+{
+	auto it = mGoodsRequired.find(reqGood);
+	if(it == mGoodsRequired.end())
+		return 0.0f;
+	return it->second.getValue(t);
+}
+
+
+namespace {
+	const char* SOTypeNames[NumSOTypes] = {
+		"Star",
+		"GasGiant",
+		"RockyNoAtmosphere",
+		"RockyOxygen",
+		"RockyNitrogen",
+		"RockyCarbonDioxide",
+		"RockyMethane"
+	};
+
+	// Splits a line into whitespace separated tokens. Double quotes group
+	// words into a single token and '#' starts a comment.
+	bool tokenize(const std::string& line, std::vector<std::string>& tokens)
+	{
+		size_t i = 0;
+		while(i < line.size()) {
+			char c = line[i];
+			if(c == '#')
+				break;
+			if(isspace((unsigned char)c)) {
+				i++;
+			} else if(c == '"') {
+				auto end = line.find('"', i + 1);
+				if(end == std::string::npos)
+					return false;
+				tokens.push_back(line.substr(i + 1, end - i - 1));
+				i = end + 1;
+			} else {
+				auto start = i;
+				while(i < line.size() && !isspace((unsigned char)line[i]) && line[i] != '#')
+					i++;
+				tokens.push_back(line.substr(start, i - start));
+			}
+		}
+		return true;
+	}
+
+	bool parseNumber(const std::string& s, float& value)
+	{
+		char* end;
+		value = strtof(s.c_str(), &end);
+		// also rejects nan, inf and numbers too large for a float
+		return !s.empty() && *end == '\0' && std::isfinite(value);
+	}
+
+	bool parseSOType(const std::string& s, SOType& t)
+	{
+		for(unsigned int i = 0; i < NumSOTypes; i++) {
+			if(s == SOTypeNames[i]) {
+				t = SOType(i);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool parseLine(const std::vector<std::string>& tok, CatalogDefinition& def, std::string& error)
+	{
+		const auto& cmd = tok[0];
+		if(cmd == "product") {
+			float v[4];
+			if(tok.size() != 6) {
+				error = "expected: product <name> <consumption> <labour> <area factor> <production cap>";
+				return false;
+			}
+			for(int i = 0; i < 4; i++) {
+				if(!parseNumber(tok[i + 2], v[i])) {
+					error = "invalid number '" + tok[i + 2] + "'";
+					return false;
+				}
+			}
+			if(tok[1] == "Labour") {
+				error = "'Labour' is reserved";
+				return false;
+			}
+			if(!def.Products.insert({tok[1], Product(tok[1], v[0], v[1], v[2], v[3])}).second) {
+				error = "product '" + tok[1] + "' defined twice";
+				return false;
+			}
+			return true;
+		}
+
+		if(cmd == "override") {
+			float value;
+			SOType t;
+			if(tok.size() != 5) {
+				error = "expected: override <name> <parameter> <SOType> <value>";
+				return false;
+			}
+			auto it = def.Products.find(tok[1]);
+			if(it == def.Products.end()) {
+				error = "unknown product '" + tok[1] + "'";
+				return false;
+			}
+			if(!parseSOType(tok[3], t)) {
+				error = "unknown SOType '" + tok[3] + "'";
+				return false;
+			}
+			if(!parseNumber(tok[4], value)) {
+				error = "invalid number '" + tok[4] + "'";
+				return false;
+			}
+			if(it->second.hasParameter(tok[2])) {
+				it->second.setOverrideValue(tok[2], t, value);
+			} else if(it->second.hasGoodRequirement(tok[2])) {
+				it->second.setGoodRequirementOverride(tok[2], t, value);
+			} else {
+				error = "'" + tok[1] + "' has no parameter or input '" + tok[2] + "'";
+				return false;
+			}
+			return true;
+		}
+
+		if(cmd == "recipe") {
+			float value;
+			if(tok.size() != 4) {
+				error = "expected: recipe <name> <input good> <quantity>";
+				return false;
+			}
+			auto it = def.Products.find(tok[1]);
+			if(it == def.Products.end()) {
+				error = "unknown product '" + tok[1] + "'";
+				return false;
+			}
+			if(!parseNumber(tok[3], value) || value <= 0.0f) {
+				error = "invalid quantity '" + tok[3] + "'";
+				return false;
+			}
+			if(it->second.hasGoodRequirement(tok[2])) {
+				error = "'" + tok[2] + "' is already an input of '" + tok[1] + "'";
+				return false;
+			}
+			it->second.setGoodRequirement(tok[2], value);
+			return true;
+		}
+
+		if(cmd == "staple") {
+			if(tok.size() != 2) {
+				error = "expected: staple <name>";
+				return false;
+			}
+			def.Staple = tok[1];
+			return true;
+		}
+
+		error = "unknown keyword '" + cmd + "'";
+		return false;
+	}
+
+	enum class Visit { None, Active, Done };
+
+	bool findCycle(const CatalogDefinition& def, const std::string& prod,
+			std::map<std::string, Visit>& visited, std::vector<std::string>& path)
+	{
+		auto& v = visited[prod];
+		if(v == Visit::Done)
+			return false;
+		path.push_back(prod);
+		if(v == Visit::Active)
+			return true;
+		v = Visit::Active;
+		for(const auto& in : def.Products.at(prod).getRequiredGoods()) {
+			if(in != "Labour" && findCycle(def, in, visited, path))
+				return true;
+		}
+		visited[prod] = Visit::Done;
+		path.pop_back();
+		return false;
+	}
+}
+
+bool parseCatalogFile(const std::string& path, CatalogDefinition& def, std::string& error)
+{
+	std::ifstream in(path);
+	if(!in) {
+		error = path + ": cannot open";
+		return false;
+	}
+
+	std::string line;
+	std::vector<std::string> tokens;
+	unsigned int lineNum = 0;
+	while(std::getline(in, line)) {
+		lineNum++;
+		tokens.clear();
+		std::string lineError;
+		if(!tokenize(line, tokens)) {
+			lineError = "unterminated quote";
+		} else if(tokens.empty()) {
+			continue;
+		} else {
+			parseLine(tokens, def, lineError);
+		}
+		if(!lineError.empty()) {
+			error = path + ":" + std::to_string(lineNum) + ": " + lineError;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool validateCatalog(const CatalogDefinition& def, std::string& error)
+{
+	if(def.Products.empty()) {
+		error = "no products defined";
+		return false;
+	}
+	if(def.Products.find(def.Staple) == def.Products.end()) {
+		error = "staple '" + def.Staple + "' is not a product";
+		return false;
+	}
+
+	for(const auto& it : def.Products) {
+		const auto& prod = it.second;
+		for(unsigned int t = 0; t < NumSOTypes; t++) {
+			if(prod.getParameter("consumption", SOType(t)) < 0.0f ||
+					prod.getParameter("productionCap", SOType(t)) < 0.0f) {
+				error = "'" + it.first + "' has a negative consumption or production cap";
+				return false;
+			}
+		}
+		for(const auto& in : prod.getRequiredGoods()) {
+			if(in != "Labour" && def.Products.find(in) == def.Products.end()) {
+				error = "'" + it.first + "' requires unknown good '" + in + "'";
+				return false;
+			}
+			for(unsigned int t = 0; t < NumSOTypes; t++) {
+				if(prod.getRequiredGoodQuantity(in, SOType(t)) < 0.0f) {
+					error = "'" + it.first + "' requires a negative quantity of '" + in + "'";
+					return false;
+				}
+			}
+		}
+	}
+
+	std::map<std::string, Visit> visited;
+	std::vector<std::string> path;
+	for(const auto& it : def.Products) {
+		if(findCycle(def, it.first, visited, path)) {
+			// the path leads up to the cycle; only report the cycle itself
+			error = "recipe cycle:";
+			auto start = std::find(path.begin(), path.end(), path.back());
+			for(auto p = start; p != path.end(); ++p)
+				error += " '" + *p + "'";
+			return false;
+		}
+	}
+	return true;
+}
+
+void compileCatalog(const CatalogDefinition& def, CompiledCatalog& c)
+{
+	std::map<std::string, ProductId> ids;
+	c.Names.clear();
+	for(const auto& it : def.Products) {
+		ids[it.first] = c.Names.size();
+		c.Names.push_back(it.first);
+	}
+	ids["Labour"] = c.Names.size();
+	c.Staple = ids.at(def.Staple);
+
+	auto cells = c.Names.size() * NumSOTypes;
+	c.Consumption.resize(cells);
+	c.ProductionCap.resize(cells);
+	c.AreaFactor.resize(cells);
+	c.RecipeStart.clear();
+	c.RecipeInputs.clear();
+	for(ProductId id = 0; id < c.Names.size(); id++) {
+		const auto& prod = def.Products.at(c.Names[id]);
+		for(unsigned int t = 0; t < NumSOTypes; t++) {
+			auto i = id * NumSOTypes + t;
+			c.Consumption[i] = prod.getParameter("consumption", SOType(t));
+			c.ProductionCap[i] = prod.getParameter("productionCap", SOType(t));
+			c.AreaFactor[i] = prod.getParameter("areaFactor", SOType(t));
+
+			c.RecipeStart.push_back(c.RecipeInputs.size());
+			for(const auto& reqGood : prod.getRequiredGoods()) {
+				c.RecipeInputs.push_back(RecipeInput { ids.at(reqGood),
+						prod.getRequiredGoodQuantity(reqGood, SOType(t)) });
+			}
+		}
+	}
+	c.RecipeStart.push_back(c.RecipeInputs.size());
+}
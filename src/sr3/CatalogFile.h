@@ -0,0 +1,72 @@
+#ifndef SR3_CATALOGFILE_H
+#define SR3_CATALOGFILE_H
+
+#include <string>
+#include <map>
+#include <vector>
+
+#include "Constants.h"
+#include "Product.h"
+
+class ProductParameter {
+	public:
+		ProductParameter(float value);
+		float getValue(SOType t) const;
+		void setOverrideValue(SOType t, float value);
+
+	private:
+		float mBaseValue;
+		std::map<SOType, float> mOverrideValue;
+};
+
+class Product {
+	public:
+		Product(const std::string& name, float consumption, float labourreq, float areafactor, float productioncap);
+
+		// getters
+		const std::string& getName() const;
+		float getParameter(const std::string& name, SOType t) const;
+		std::vector<std::string> getRequiredGoods() const;
+		float getRequiredGoodQuantity(const std::string& reqGood, SOType t) const;
+		bool hasParameter(const std::string& name) const;
+		bool hasGoodRequirement(const std::string& name) const;
+
+		// setters
+		void setOverrideValue(const std::string& name, SOType t, float value);
+		void setGoodRequirement(const std::string& name, float value);
+		void setGoodRequirementOverride(const std::string& name, SOType t, float value);
+
+	private:
+		std::map<std::string, ProductParameter> mParameters;
+		std::map<std::string, ProductParameter> mGoodsRequired;
+		std::string mName;
+};
+
+// Product definitions as read from a catalog text file.
+struct CatalogDefinition {
+	std::map<std::string, Product> Products;
+	std::string Staple;
+};
+
+// Both return false and set error to a message on failure.
+bool parseCatalogFile(const std::string& path, CatalogDefinition& def, std::string& error);
+
+// Checks that every recipe input is defined and the recipe graph has no cycles.
+bool validateCatalog(const CatalogDefinition& def, std::string& error);
+
+// The tables of ProductCatalog, indexed by [product][SOType]. Products are
+// sorted by name and Labour has the ID one past the last product.
+struct CompiledCatalog {
+	std::vector<std::string> Names;
+	ProductId Staple;
+	std::vector<float> Consumption;
+	std::vector<float> ProductionCap;
+	std::vector<float> AreaFactor;
+	std::vector<unsigned int> RecipeStart;
+	std::vector<RecipeInput> RecipeInputs;
+};
+
+// def must have been validated.
+void compileCatalog(const CatalogDefinition& def, CompiledCatalog& c);
+
+#endif
@@ -1,6 +1,8 @@
 #ifndef SR3_CONSTANTS_H
 #define SR3_CONSTANTS_H
 
+#include "Money.h"
+
 namespace Constants {
 	const float SolarSystemSpeedCoefficient = 10.0f;
 	const float PlanetSizeCoefficient = 500.0f;
@@ -8,10 +10,62 @@ namespace Constants {
 
 	const unsigned int MaxPopulation = 1000000;
 	const unsigned int MinPopulationForColonisation = 400;
-	const unsigned int MinPopulationMoneyForColonisation = 10000.0f;
+	const Money MinPopulationMoneyForColonisation = Money::credits(10000);
 	const float PercentagePopulationColonised = 0.05f;
+	// settlements with no more people than this are abandoned after their update
+	const unsigned int MinSettlementPopulation = 20;
+	// settled updates (see Settlement::isSettled()) before a settlement is put to sleep
+	const unsigned int SettlementSleepUpdates = 4;
+	// largest relative change of the money and the total stock of the
+	// market in an update that still counts as settled
+	const float SettledMarketChange = 0.01f;
+	// settlements this large are updated every tick, smaller ones less
+	// often, down to once every MaxSettlementInterval ticks
+	const unsigned int FullRatePopulation = 10000;
+	const unsigned int MaxSettlementInterval = 4;
+	// settlements whose market volatility is at least this are updated
+	// every tick, see MarketTable::getVolatility()
+	const float VolatileMarket = 0.1f;
+
+	// prices that run away with nothing in stock stop here, well within
+	// what Money can hold for a market's whole labour loan
+	const float MaxPrice = 1000000000.0f;
 
 	const unsigned int SpaceShipCargoSpace = 2000;
+	const float SpaceShipEnginePower = 1000.0f;
+	const float SpaceShipSidePower = 2.0f;
+
+	// AI traders in the observed system
+	const unsigned int MaxSolarShips = 200;
+	const unsigned int SolarShipsPerTradeSource = 20;
+	// traders that have not traded for this long (in seconds), or have
+	// neither money nor cargo left, are despawned
+	const float TraderIdleDespawnTime = 300.0f;
+	const Money TraderMinMoney = Money::credits(1);
+	// seconds an AI trader stays landed
+	const float ShipLandedTime = 5.0f;
+	// AI traders in flight steer again after half the time they need to
+	// reach their target, but within these bounds (in seconds)
+	const float ShipMinSteerInterval = 0.1f;
+	const float ShipMaxSteerInterval = 0.2f;
+	// time in milliseconds per frame for choosing the next trades of
+	// AI traders; the others wait at their market for a later frame
+	const double AIPlanBudget = 0.5;
+
+	const unsigned int NumGalaxySystems = 16;
+	const unsigned int InitialFleetSize = 5;
+	// number of trade runs one trader of an unobserved system makes per econ tick
+	const float DormantTripsPerTick = 0.5f;
+	// time in milliseconds per frame the econ tick may take while
+	// playing; the rest of the tick runs in the following frames
+	const double EconTickBudget = 2.0;
+	// run the econ tick on a worker thread instead of in steps of
+	// EconTickBudget on the main thread
+	const bool AsyncEconTick = true;
+	// share of the econ state at the start of the game kept in memory;
+	// the least recently observed systems beyond it are paged out to a
+	// file in the cache directory
+	const float ResidentStateShare = 0.5f;
 }
 
 enum class SOType {
@@ -24,6 +78,8 @@ enum class SOType {
 	RockyMethane
 };
 
+const unsigned int NumSOTypes = (unsigned int)SOType::RockyMethane + 1;
+
 namespace Econ {
 	enum class Entity {
 		Population,
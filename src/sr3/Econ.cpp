@@ -1,17 +1,46 @@
 #include <cassert>
+#include <algorithm>
 
 #include "Econ.h"
 
 #include "SolarObject.h"
 
+#include "common/Random.h"
+
 namespace Econ {
+	thread_local Stats* Stats::Redirect = nullptr;
+	thread_local RandomStream* RandomStream::Current = nullptr;
+
+	float uniform()
+	{
+		if(RandomStream::Current)
+			return RandomStream::Current->uniform();
+		else
+			return Common::Random::uniform();
+	}
+
+	void uniforms(float* out, unsigned int n)
+	{
+		if(RandomStream::Current) {
+			RandomStream::Current->uniforms(out, n);
+		} else {
+			for(unsigned int i = 0; i < n; i++)
+				out[i] = Common::Random::uniform();
+		}
+	}
+
 	Stats* Stats::getInstance()
 	{
 		static Stats Instance;
-		return &Instance;
+		return Redirect ? Redirect : &Instance;
 	}
 
-	void Stats::addEvent(Econ::Event event, const std::string& product,
+	Stats::Stats(const Stats* base)
+		: mBase(base)
+	{
+	}
+
+	void Stats::addEvent(Econ::Event event, ProductId product,
 			Econ::Entity ent, const SolarObject* obj, unsigned int num)
 	{
 		DataSet& ds = mData[obj][product];
@@ -54,20 +83,44 @@ namespace Econ {
 		}
 	}
 
+	void Stats::merge(const Stats& other)
+	{
+		for(const auto& it : other.mData) {
+			auto& data = mData[it.first];
+			for(ProductId prod = 0; prod < data.size(); prod++) {
+				DataSet& ds = data[prod];
+				ds.Production  += it.second[prod].Production;
+				ds.Consumption += it.second[prod].Consumption;
+				ds.Import      += it.second[prod].Import;
+				ds.Export      += it.second[prod].Export;
+			}
+		}
+	}
+
 	void Stats::clearData()
 	{
-		mData.clear();
+		// keep the per-object arrays so that the next tick does not allocate
+		for(auto& it : mData)
+			std::fill(it.second.begin(), it.second.end(), DataSet());
 	}
 
-	DataSet Stats::getData(const SolarObject* obj, const std::string& product) const
+	DataSet Stats::getData(const SolarObject* obj, ProductId product) const
 	{
+		DataSet ret = mBase ? mBase->getData(obj, product) : DataSet();
 		auto it = mData.find(obj);
 		if(it == mData.end())
-			return DataSet();
-		auto it2 = it->second.find(product);
-		if(it2 == it->second.end())
-			return DataSet();
-		return it2->second;
+			return ret;
+		const auto& ds = it->second[product];
+		ret.Production  += ds.Production;
+		ret.Consumption += ds.Consumption;
+		ret.Import      += ds.Import;
+		ret.Export      += ds.Export;
+		return ret;
+	}
+
+	DataSet Stats::getData(const SolarObject* obj, const std::string& product) const
+	{
+		return getData(obj, ProductCatalog::getInstance()->getId(product));
 	}
 
 }
@@ -2,8 +2,11 @@
 #define SR3_ECON_H
 
 #include <map>
+#include <string>
+#include <random>
 
 #include "Constants.h"
+#include "Product.h"
 
 class SolarObject;
 
@@ -17,17 +20,70 @@ namespace Econ {
 
 	class Stats {
 		public:
+			// A local Stats only records its own events and adds them
+			// on top of the base data on lookup.
+			Stats(const Stats* base = nullptr);
 			static Stats* getInstance();
-			void addEvent(Econ::Event event, const std::string& product,
+			void addEvent(Econ::Event event, ProductId product,
 					Econ::Entity ent, const SolarObject* obj, unsigned int num);
 			void clearData();
+			DataSet getData(const SolarObject* obj, ProductId product) const;
 			DataSet getData(const SolarObject* obj, const std::string& product) const;
+			void merge(const Stats& other);
 
 		private:
-			Stats() { }
+			friend class StatsRedirect;
 
-			std::map<const SolarObject*, std::map<std::string, DataSet>> mData;
+			const Stats* mBase = nullptr;
+			std::map<const SolarObject*, PerProduct<DataSet>> mData;
+			static thread_local Stats* Redirect;
 	};
+
+	// redirects the stats events of this thread for the lifetime of the object
+	class StatsRedirect {
+		public:
+			StatsRedirect(Stats* s) : mOld(Stats::Redirect) { Stats::Redirect = s; }
+			~StatsRedirect() { Stats::Redirect = mOld; }
+
+		private:
+			Stats* mOld;
+	};
+
+	// Random numbers for the economy. A parallel tick installs one stream
+	// per shard so that the results do not depend on thread scheduling.
+	class RandomStream {
+		public:
+			RandomStream(unsigned int seed) : mGen(seed) { }
+			float uniform() { return (mGen() >> 8) * (1.0f / 16777216.0f); }
+			void uniforms(float* out, unsigned int n)
+			{
+				for(unsigned int i = 0; i < n; i++)
+					out[i] = uniform();
+			}
+
+		private:
+			friend class RandomRedirect;
+			friend float uniform();
+			friend void uniforms(float* out, unsigned int n);
+
+			std::mt19937 mGen;
+			static thread_local RandomStream* Current;
+	};
+
+	class RandomRedirect {
+		public:
+			RandomRedirect(RandomStream* r) : mOld(RandomStream::Current) { RandomStream::Current = r; }
+			~RandomRedirect() { RandomStream::Current = mOld; }
+
+		private:
+			RandomStream* mOld;
+	};
+
+	// uniform random number from the stream of this thread, or
+	// Common::Random if no stream is installed
+	float uniform();
+	// fills out with n numbers as if drawn with uniform() one by one
+	void uniforms(float* out, unsigned int n);
 }
 
 #endif
@@ -0,0 +1,120 @@
+#include <cassert>
+
+#include "EconFork.h"
+
+#include "SolarObject.h"
+#include "Settlement.h"
+#include "EconSnapshot.h"
+
+namespace Econ {
+	Fork::Fork(const std::vector<SolarObject*>& objects, unsigned int seed)
+		: mObjects(objects),
+		mRandom(seed),
+		mStats(Stats::getInstance())
+	{
+	}
+
+	Fork::Fork(const EconSnapshot& snapshot, const std::vector<SolarObject*>& objects,
+			unsigned int seed)
+		: mObjects(objects),
+		mSnapshot(&snapshot),
+		mRandom(seed),
+		mStats(Stats::getInstance())
+	{
+	}
+
+	Fork::~Fork()
+	{
+		for(auto it : mSettlements)
+			delete it.second;
+	}
+
+	void Fork::update(unsigned int ticks)
+	{
+		StatsRedirect redir(&mStats);
+		RandomRedirect randomRedirect(&mRandom);
+		for(unsigned int i = 0; i < ticks; i++) {
+			// only the markets copied so far are in the table
+			mMarkets.updatePrices();
+			// in object order so that the random numbers are drawn in a
+			// fixed order
+			for(auto obj : mObjects) {
+				auto it = mSettlements.find(obj);
+				if(it != mSettlements.end())
+					it->second->update();
+			}
+			mTicks++;
+		}
+	}
+
+	template<typename T>
+	unsigned int Fork::buy(const SolarObject* obj, const std::string& product, unsigned int number,
+			T& buyer)
+	{
+		StatsRedirect redir(&mStats);
+		return getWritableSettlement(obj)->getMarket()->buy(product, number, buyer,
+				Entity::Trader, obj);
+	}
+
+	template<typename T>
+	unsigned int Fork::sell(const SolarObject* obj, const std::string& product, unsigned int number,
+			T& seller)
+	{
+		StatsRedirect redir(&mStats);
+		return getWritableSettlement(obj)->getMarket()->sell(product, number, seller,
+				Entity::Trader, obj);
+	}
+
+	template unsigned int Fork::buy(const SolarObject*, const std::string&, unsigned int, Trader&);
+	template unsigned int Fork::buy(const SolarObject*, const std::string&, unsigned int, ShipTrader&);
+	template unsigned int Fork::sell(const SolarObject*, const std::string&, unsigned int, Trader&);
+	template unsigned int Fork::sell(const SolarObject*, const std::string&, unsigned int, ShipTrader&);
+
+	const Settlement* Fork::getSettlement(const SolarObject* obj)
+	{
+		auto it = mSettlements.find(obj);
+		if(it != mSettlements.end())
+			return it->second;
+		if(mTicks && getBase(obj))
+			return getWritableSettlement(obj);
+		return getBase(obj);
+	}
+
+	const Settlement* Fork::getBase(const SolarObject* obj) const
+	{
+		return mSnapshot ? mSnapshot->getSettlement(obj) : obj->getSettlement();
+	}
+
+	const Market* Fork::getMarket(const SolarObject* obj)
+	{
+		auto s = getSettlement(obj);
+		assert(s);
+		return s->getMarket();
+	}
+
+	DataSet Fork::getData(const SolarObject* obj, const std::string& product) const
+	{
+		return mStats.getData(obj, product);
+	}
+
+	Settlement* Fork::getWritableSettlement(const SolarObject* obj)
+	{
+		auto it = mSettlements.find(obj);
+		if(it != mSettlements.end())
+			return it->second;
+		auto base = getBase(obj);
+		assert(base);
+		auto s = base->clone(&mMarkets);
+		mSettlements[obj] = s;
+
+		// catch up with the ticks run before it was copied
+		StatsRedirect redir(&mStats);
+		RandomRedirect randomRedirect(&mRandom);
+		for(unsigned int i = 0; i < mTicks; i++) {
+			mMarkets.updatePrices(s->getMarket()->getColumn());
+			s->update();
+		}
+		return s;
+	}
+}
+
@@ -0,0 +1,73 @@
+#ifndef SR3_ECONFORK_H
+#define SR3_ECONFORK_H
+
+#include <string>
+#include <map>
+#include <vector>
+
+#include "Econ.h"
+#include "Settlement.h"
+
+class SolarObject;
+class Settlement;
+class Market;
+class EconSnapshot;
+
+namespace Econ {
+	// A throwaway what-if copy of the economy of a set of solar objects.
+	// Creating a fork is O(1): settlements are only copied the first time
+	// the fork writes to them, everything else is read from the base, which
+	// is either the live state or a snapshot. The base must not be modified
+	// while the fork is in use. The fork draws its random numbers from a
+	// stream of its own, so running it does not change the live economy.
+	//
+	// update() only advances the settlements copied so far. Settlements do
+	// not affect each other within a tick, so the others are brought
+	// forward by the ticks run when they are first read or written.
+	class Fork {
+		public:
+			Fork(const std::vector<SolarObject*>& objects, unsigned int seed = 1);
+			Fork(const EconSnapshot& snapshot, const std::vector<SolarObject*>& objects,
+					unsigned int seed = 1);
+			~Fork();
+			Fork(const Fork&) = delete;
+			Fork(const Fork&&) = delete;
+			Fork& operator=(const Fork&) & = delete;
+			Fork& operator=(Fork&&) & = delete;
+
+			// advances the prices and Settlement::update on all
+			// settlements. Colonisation is not simulated in a fork.
+			void update(unsigned int ticks = 1);
+			unsigned int getTicks() const { return mTicks; }
+			// instantiated for Trader and ShipTrader
+			template<typename T>
+			unsigned int buy(const SolarObject* obj, const std::string& product, unsigned int number,
+					T& buyer);
+			template<typename T>
+			unsigned int sell(const SolarObject* obj, const std::string& product, unsigned int number,
+					T& seller);
+
+			// copies the settlement if the fork has run ticks since
+			const Settlement* getSettlement(const SolarObject* obj);
+			const Market* getMarket(const SolarObject* obj);
+			DataSet getData(const SolarObject* obj, const std::string& product) const;
+			unsigned int getNumCopied() const { return mSettlements.size(); }
+
+		private:
+			// null if the object has no settlement in the base
+			const Settlement* getBase(const SolarObject* obj) const;
+			Settlement* getWritableSettlement(const SolarObject* obj);
+
+			std::vector<SolarObject*> mObjects;
+			const EconSnapshot* mSnapshot = nullptr;
+			RandomStream mRandom;
+			unsigned int mTicks = 0;
+			// markets of the copied settlements
+			MarketTable mMarkets;
+			std::map<const SolarObject*, Settlement*> mSettlements;
+			Stats mStats;
+	};
+}
+
+#endif
+
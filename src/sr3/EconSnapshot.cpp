@@ -0,0 +1,60 @@
+#include <cassert>
+
+#include "EconSnapshot.h"
+#include "SolarObject.h"
+#include "Settlement.h"
+
+EconSnapshot::~EconSnapshot()
+{
+	clear();
+}
+
+void EconSnapshot::take(const std::vector<SolarObject*>& objects, const TradeNetwork& network)
+{
+	for(auto it = mSettlements.begin(); it != mSettlements.end(); ) {
+		if(it->first->hasSettlement()) {
+			++it;
+		} else {
+			delete it->second;
+			it = mSettlements.erase(it);
+		}
+	}
+	for(auto obj : objects) {
+		if(!obj->hasSettlement())
+			continue;
+		auto& s = mSettlements[obj];
+		if(s)
+			s->copyState(*obj->getSettlement());
+		else
+			s = obj->getSettlement()->clone(&mMarkets);
+	}
+	mTradeNetwork.copyTradeRoutes(network);
+}
+
+const Settlement* EconSnapshot::getSettlement(const SolarObject* obj) const
+{
+	auto it = mSettlements.find(obj);
+	return it == mSettlements.end() ? nullptr : it->second;
+}
+
+const Market* EconSnapshot::getMarket(const SolarObject* obj) const
+{
+	auto s = getSettlement(obj);
+	assert(s);
+	return s->getMarket();
+}
+
+float EconSnapshot::getMargin(const TradeRoute& tr) const
+{
+	auto id = tr.getProductId();
+	return getMarket(tr.getTo())->getPrice(id) - getMarket(tr.getFrom())->getPrice(id);
+}
+
+void EconSnapshot::clear()
+{
+	for(auto it : mSettlements)
+		delete it.second;
+	mSettlements.clear();
+	mMarkets.clear();
+}
+
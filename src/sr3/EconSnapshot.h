@@ -0,0 +1,48 @@
+#ifndef SR3_ECONSNAPSHOT_H
+#define SR3_ECONSNAPSHOT_H
+
+#include <map>
+#include <vector>
+
+#include "MarketTable.h"
+#include "SolarSystem.h"
+
+class SolarObject;
+class Settlement;
+class Market;
+
+// A copy of the settlements and trade routes of a solar system as of the
+// end of an econ tick. When the tick runs on a worker thread, the UI and
+// the ships read the economy of the observed system through the snapshot
+// of the last tick instead of through the solar objects.
+class EconSnapshot {
+	public:
+		EconSnapshot() = default;
+		~EconSnapshot();
+		EconSnapshot(const EconSnapshot&) = delete;
+		EconSnapshot(const EconSnapshot&&) = delete;
+		EconSnapshot& operator=(const EconSnapshot&) & = delete;
+		EconSnapshot& operator=(EconSnapshot&&) & = delete;
+
+		// replaces the snapshot with the current state of the objects; the
+		// settlements of the last snapshot are overwritten in place, so
+		// only newly founded ones allocate
+		void take(const std::vector<SolarObject*>& objects, const TradeNetwork& network);
+		// null if the object had no settlement
+		const Settlement* getSettlement(const SolarObject* obj) const;
+		const Market* getMarket(const SolarObject* obj) const;
+		bool hasMarket(const SolarObject* obj) const { return getSettlement(obj) != nullptr; }
+		const TradeNetwork& getTradeNetwork() const { return mTradeNetwork; }
+		// price at the destination minus price at the source
+		float getMargin(const TradeRoute& tr) const;
+
+	private:
+		void clear();
+
+		MarketTable mMarkets;
+		std::map<const SolarObject*, Settlement*> mSettlements;
+		TradeNetwork mTradeNetwork;
+};
+
+#endif
+
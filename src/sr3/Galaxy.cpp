@@ -0,0 +1,424 @@
+#include <cassert>
+#include <climits>
+#include <algorithm>
+#include <chrono>
+
+#include "Galaxy.h"
+#include "SolarSystem.h"
+#include "Econ.h"
+#include "Pager.h"
+#include "StateBuffer.h"
+
+struct Galaxy::Shard {
+	Shard(unsigned int seed) : Random(seed) { }
+
+	Econ::RandomStream Random;
+	Econ::Stats Stats;
+	std::vector<Shipment> Inbox;
+	std::vector<Shipment> Outbox;
+	std::map<std::string, PriceRange> Prices[2];
+	ShardStats Timing;
+	std::chrono::steady_clock::time_point Finished;
+	// progress of the current tick: the settlement stages and the trade
+	// network run as separate tasks, the last one to finish finishes
+	// the tick of the shard
+	bool Started = false;
+	bool SettlementsDone = true;
+	bool NetworkDone = true;
+	std::atomic<unsigned int> TasksLeft{0};
+	bool Done = true;
+
+	// paging
+	int Page = -1;
+	unsigned long long LastAccess = 0;
+	size_t StateSize = 0;
+};
+
+Galaxy::Galaxy(unsigned int numSystems, unsigned int numThreads)
+	: mPool(numThreads)
+{
+	assert(numSystems > 0);
+	mSystems.push_back(new SolarSystem());
+	for(unsigned int i = 1; i < numSystems; i++) {
+		SystemParameters params;
+		params.Seed = i * 7919;
+		params.NumPlanets = 3 + i % 8;
+		params.NumMoons = params.NumPlanets * 2;
+		auto s = new SolarSystem(params);
+		s->setFleetSize(Constants::InitialFleetSize);
+		s->getFleetTrader().addMoney(Money::credits(Constants::InitialFleetSize * Constants::SpaceShipCargoSpace * 5));
+		mSystems.push_back(s);
+	}
+	for(unsigned int i = 0; i < numSystems; i++)
+		mShards.push_back(new Shard(i + 1));
+	mSystemTime.resize(numSystems, 0.0);
+	mSystems[mActive]->takeSnapshot();
+	mSystems[mActive]->publishSnapshot();
+}
+
+Galaxy::~Galaxy()
+{
+	stepTick(-1.0);
+	delete mPager;
+	for(auto s : mShards)
+		delete s;
+	for(auto s : mSystems)
+		delete s;
+}
+
+SolarSystem& Galaxy::getSystem(unsigned int i)
+{
+	pageIn(i);
+	touch(i);
+	return *mSystems.at(i);
+}
+
+void Galaxy::setActiveSystem(unsigned int i)
+{
+	assert(i < mSystems.size());
+	stepTick(-1.0);
+	pageIn(i);
+	touch(i);
+	mSystemTime[mActive] = mTime;
+	mActive = i;
+
+	// catch up with the orbits of the newly observed system
+	mSystems[mActive]->update(mTime - mSystemTime[mActive]);
+	mSystemTime[mActive] = mTime;
+	mSystems[mActive]->takeSnapshot();
+	mSystems[mActive]->publishSnapshot();
+}
+
+void Galaxy::update(float time)
+{
+	mTime += time;
+	mSystems[mActive]->update(time);
+	mSystemTime[mActive] = mTime;
+}
+
+void Galaxy::updateSettlements()
+{
+	beginTick();
+	stepTick(-1.0);
+}
+
+void Galaxy::beginTick()
+{
+	if(mTicking)
+		stepTick(-1.0);
+
+	touch(mActive);
+	// the shard that runs without its fleet is fixed for the whole tick
+	mTickActive = mActive;
+	mTickTasks.clear();
+	for(unsigned int i = 0; i < mSystems.size(); i++) {
+		if(mSystems[i]->isResident()) {
+			auto& shard = *mShards[i];
+			shard.Started = false;
+			shard.SettlementsDone = false;
+			shard.NetworkDone = false;
+			shard.TasksLeft.store(2);
+			shard.Done = false;
+			mSystems[i]->getTimeline().reset();
+			mTickTasks.push_back([this, i] { stepShard(i); });
+			mTickTasks.push_back([this, i] { stepNetwork(i); });
+		}
+	}
+	mTicking = true;
+
+	if(mAsync) {
+		mDeadline = std::chrono::steady_clock::time_point::max();
+		mTickFinished.store(false);
+		mTickThread = std::thread([this] {
+				mPool.run(mTickTasks);
+				mTickFinished.store(true, std::memory_order_release); });
+	}
+}
+
+bool Galaxy::stepTick(double budget)
+{
+	if(!mTicking)
+		return true;
+
+	// a negative budget runs the tick to the end
+	if(mAsync) {
+		if(budget >= 0.0 && !mTickFinished.load(std::memory_order_acquire))
+			return false;
+		mTickThread.join();
+	} else {
+		mDeadline = budget < 0.0 ? std::chrono::steady_clock::time_point::max() :
+			std::chrono::steady_clock::now() +
+			std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(budget));
+		mPool.run(mTickTasks);
+		for(auto shard : mShards) {
+			if(!shard->Done)
+				return false;
+		}
+	}
+	barrier();
+	mTicking = false;
+	return true;
+}
+
+void Galaxy::barrier()
+{
+	// merge the shard data in shard order
+	auto barrier = std::chrono::steady_clock::now();
+	for(auto shard : mShards) {
+		if(shard->Page == -1)
+			shard->Timing.BarrierWait = std::chrono::duration<double, std::milli>(barrier - shard->Finished).count();
+		Econ::Stats::getInstance()->merge(shard->Stats);
+		shard->Stats.clearData();
+		for(const auto& s : shard->Outbox)
+			deliver(s);
+		shard->Outbox.clear();
+	}
+	mPublished = 1 - mPublished;
+	mSystems[mTickActive]->publishSnapshot();
+	enforceBudget();
+}
+
+void Galaxy::stepShard(unsigned int i)
+{
+	auto& shard = *mShards[i];
+	if(shard.SettlementsDone)
+		return;
+
+	auto start = std::chrono::steady_clock::now();
+	auto& system = *mSystems[i];
+	Econ::StatsRedirect statsRedirect(&shard.Stats);
+	Econ::RandomRedirect randomRedirect(&shard.Random);
+
+	if(!shard.Started) {
+		shard.Timing.TickTime = 0.0;
+		for(const auto& s : shard.Inbox)
+			system.importGoods(s.Product, s.Quantity);
+		shard.Inbox.clear();
+		system.getTimeline().mark(EconStage::Imports, start, std::chrono::steady_clock::now());
+
+		system.beginTick();
+		shard.Started = true;
+	}
+	shard.SettlementsDone = system.stepTick(mDeadline);
+	shard.Timing.TickTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	if(shard.SettlementsDone && shard.TasksLeft.fetch_sub(1) == 1)
+		finishShard(i);
+}
+
+void Galaxy::stepNetwork(unsigned int i)
+{
+	auto& shard = *mShards[i];
+	if(shard.NetworkDone)
+		return;
+
+	shard.NetworkDone = mSystems[i]->stepTradeNetwork(mDeadline);
+	if(shard.NetworkDone && shard.TasksLeft.fetch_sub(1) == 1)
+		finishShard(i);
+}
+
+void Galaxy::finishShard(unsigned int i)
+{
+	auto& shard = *mShards[i];
+	auto start = std::chrono::steady_clock::now();
+	auto& system = *mSystems[i];
+	Econ::StatsRedirect statsRedirect(&shard.Stats);
+	Econ::RandomRedirect randomRedirect(&shard.Random);
+
+	// the fleet trades on the routes of the previous tick
+	if(i != mTickActive) {
+		system.updateFleetTrade();
+		auto exports = std::chrono::steady_clock::now();
+		system.getTimeline().mark(EconStage::FleetTrade, start, exports);
+		exportGoods(i);
+		system.getTimeline().mark(EconStage::Exports, exports, std::chrono::steady_clock::now());
+	}
+	system.endTick();
+	if(i == mTickActive)
+		system.takeSnapshot();
+	system.getPriceRanges(shard.Prices[1 - mPublished]);
+
+	shard.Finished = std::chrono::steady_clock::now();
+	shard.Timing.TickTime += std::chrono::duration<double, std::milli>(shard.Finished - start).count();
+	shard.Done = true;
+}
+
+void Galaxy::exportGoods(unsigned int i)
+{
+	// the systems form a ring; ship at most one cargo hold to each neighbour
+	if(mSystems.size() < 2)
+		return;
+
+	unsigned int num = mSystems.size();
+	unsigned int neighbours[2] = { (i + 1) % num, (i + num - 1) % num };
+	const auto& own = mShards[i]->Prices[mPublished];
+	for(unsigned int j = 0; j < 2; j++) {
+		auto to = neighbours[j];
+		if(j == 1 && to == neighbours[0])
+			break;
+
+		const auto& other = mShards[to]->Prices[mPublished];
+		const std::string* bestProduct = nullptr;
+		float bestRatio = 1.5f;
+		for(const auto& it : own) {
+			auto it2 = other.find(it.first);
+			if(it2 == other.end() || it.second.Lowest == FLT_MAX)
+				continue;
+			auto ratio = it2->second.Highest / it.second.Lowest;
+			if(ratio > bestRatio) {
+				bestRatio = ratio;
+				bestProduct = &it.first;
+			}
+		}
+
+		if(bestProduct) {
+			auto num = mSystems[i]->exportGoods(*bestProduct, Constants::SpaceShipCargoSpace);
+			if(num)
+				mShards[i]->Outbox.push_back({i, to, *bestProduct, num});
+		}
+	}
+}
+
+const ShardStats& Galaxy::getShardStats(unsigned int i) const
+{
+	return mShards.at(i)->Timing;
+}
+
+bool Galaxy::enablePaging(const std::string& path, float residentShare)
+{
+	assert(!mPager);
+	mPager = new Pager(path);
+	if(!mPager->isOpen()) {
+		delete mPager;
+		mPager = nullptr;
+		return false;
+	}
+	for(unsigned int i = 0; i < mShards.size(); i++)
+		measure(i);
+	mResidentBudget = getResidentBytes() * residentShare;
+	return true;
+}
+
+void Galaxy::setAsyncTick(bool b)
+{
+	stepTick(-1.0);
+	mAsync = b;
+}
+
+void Galaxy::setCallAuction(bool b)
+{
+	// paged out systems keep the setting for when they are loaded
+	for(auto s : mSystems)
+		s->setCallAuction(b);
+}
+
+size_t Galaxy::getResidentBytes() const
+{
+	size_t total = 0;
+	for(auto shard : mShards) {
+		if(shard->Page == -1)
+			total += shard->StateSize;
+	}
+	return total;
+}
+
+size_t Galaxy::getPagedBytes() const
+{
+	return mPager ? mPager->getStoredBytes() : 0;
+}
+
+void Galaxy::touch(unsigned int i)
+{
+	mShards[i]->LastAccess = ++mAccessCounter;
+}
+
+void Galaxy::measure(unsigned int i)
+{
+	StateWriter counter(true);
+	mSystems[i]->saveState(counter);
+	mShards[i]->StateSize = counter.size();
+}
+
+void Galaxy::deliver(const Shipment& s)
+{
+	auto& inbox = mShards[s.To]->Inbox;
+	if(mShards[s.To]->Page != -1) {
+		// a paged out system may wait for long, so keep one entry per product
+		for(auto& in : inbox) {
+			if(in.Product == s.Product) {
+				in.Quantity += std::min(s.Quantity, UINT_MAX - in.Quantity);
+				return;
+			}
+		}
+	}
+	inbox.push_back(s);
+}
+
+void Galaxy::pageIn(unsigned int i)
+{
+	auto& shard = *mShards[i];
+	if(shard.Page == -1)
+		return;
+
+	assert(mPager);
+	size_t len;
+	auto data = mPager->get(shard.Page, &len);
+	StateReader r(data, len);
+	mSystems[i]->loadState(r);
+	mPager->release(shard.Page);
+	// the size stays the one measured when it was paged out
+	shard.Page = -1;
+}
+
+bool Galaxy::pageOut(unsigned int i)
+{
+	assert(mPager);
+	assert(i != mActive);
+	auto& shard = *mShards[i];
+	assert(shard.Page == -1);
+
+	StateWriter w;
+	mSystems[i]->saveState(w);
+	auto handle = mPager->store(w.data(), w.size());
+	if(handle < 0)
+		return false;
+
+	mSystems[i]->evictState();
+	shard.Page = handle;
+	shard.StateSize = w.size();
+	// the neighbours keep seeing the last published prices
+	shard.Prices[1 - mPublished] = shard.Prices[mPublished];
+	return true;
+}
+
+void Galaxy::enforceBudget()
+{
+	if(!mPager)
+		return;
+
+	// keeps the sizes of the resident systems from going stale
+	for(unsigned int n = 0; n < mShards.size(); n++) {
+		auto i = mNextMeasure++ % mShards.size();
+		if(mShards[i]->Page == -1) {
+			measure(i);
+			break;
+		}
+	}
+
+	auto resident = getResidentBytes();
+	while(resident > mResidentBudget) {
+		int lru = -1;
+		for(unsigned int i = 0; i < mShards.size(); i++) {
+			if(i == mActive || mShards[i]->Page != -1)
+				continue;
+			if(lru == -1 || mShards[i]->LastAccess < mShards[lru]->LastAccess)
+				lru = i;
+		}
+		if(lru == -1)
+			break;
+
+		if(!pageOut(lru))
+			break;
+		resident = getResidentBytes();
+	}
+}
+
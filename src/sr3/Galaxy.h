@@ -0,0 +1,142 @@
+#ifndef SR3_GALAXY_H
+#define SR3_GALAXY_H
+
+#include <string>
+#include <map>
+#include <vector>
+#include <chrono>
+#include <atomic>
+#include <thread>
+
+#include "ThreadPool.h"
+
+class SolarSystem;
+class Pager;
+struct PriceRange;
+
+// goods sent by the aggregate fleet of one system to a neighbouring one
+struct Shipment {
+	unsigned int From;
+	unsigned int To;
+	std::string Product;
+	unsigned int Quantity;
+};
+
+// timings of the last econ tick of a shard in milliseconds; a tick run
+// in steps adds up the time of its steps
+struct ShardStats {
+	double TickTime = 0.0;
+	double BarrierWait = 0.0;
+};
+
+// Only the active system (the one with the player) runs physics and
+// per-ship AI. The other systems only run their economy, with their
+// traders simulated as an aggregate fleet.
+//
+// Each system is a shard of the econ tick. Shards run concurrently on
+// a thread pool and only exchange shipments at the barrier at the end
+// of the tick; a shipment is delivered at the start of the next tick.
+// Shippers decide on the price ranges published at the previous barrier
+// so that the result does not depend on thread scheduling.
+//
+// The trade network stage of a shard is a task of its own: it builds the
+// routes from the markets as of the end of the previous tick while the
+// settlement stages run (see EconStage), and the fleet trades on these
+// routes once both tasks are done.
+//
+// With paging enabled, systems that do not fit in the resident budget are
+// paged out to a backing file, least recently observed first. Paged out
+// systems are frozen until they are accessed again through getSystem()
+// or setActiveSystem(); shipments to them wait in their inbox, summed up
+// per product. The state sizes are measured when paging is enabled and
+// when a system is paged out, and for one resident system per tick in turn.
+class Galaxy {
+	public:
+		// the econ tick runs on the given number of threads, by default
+		// one per core
+		Galaxy(unsigned int numSystems, unsigned int numThreads = std::thread::hardware_concurrency());
+		~Galaxy();
+		Galaxy(const Galaxy&) = delete;
+		Galaxy(const Galaxy&&) = delete;
+		Galaxy& operator=(const Galaxy&) & = delete;
+		Galaxy& operator=(Galaxy&&) & = delete;
+
+		unsigned int getNumSystems() const { return mSystems.size(); }
+		SolarSystem& getSystem(unsigned int i);
+		// does not page in the system
+		const SolarSystem& getSystem(unsigned int i) const { return *mSystems.at(i); }
+		unsigned int getActiveSystemIndex() const { return mActive; }
+		SolarSystem& getActiveSystem() { return *mSystems[mActive]; }
+		const SolarSystem& getActiveSystem() const { return *mSystems[mActive]; }
+		void setActiveSystem(unsigned int i);
+		void update(float time);
+		void updateSettlements();
+		// The econ tick spread over frames. beginTick() starts a tick,
+		// finishing the previous one first if it is still running, and
+		// each stepTick() runs the shards for at most about the given
+		// budget in milliseconds. Returns true once the tick has passed
+		// the barrier. Systems are updated in the same order as by
+		// updateSettlements(), so only trade by the ships of the active
+		// system in between the steps changes the result.
+		void beginTick();
+		bool stepTick(double budget);
+		bool isTicking() const { return mTicking; }
+		// With async ticks beginTick() runs the whole tick on a worker
+		// thread and stepTick() only checks whether it has finished.
+		// Either way the econ state must not be touched while a tick
+		// runs, so the UI and the ships read the snapshot of the active
+		// system (see SolarSystem::getSnapshot()), which is taken at the
+		// end of its tick and published at the barrier.
+		void setAsyncTick(bool b);
+		const ShardStats& getShardStats(unsigned int i) const;
+		unsigned int getNumThreads() const { return mPool.getNumThreads(); }
+		// keeps the given share of the econ state, as measured now, in
+		// memory and pages out the least recently observed systems
+		// beyond it
+		bool enablePaging(const std::string& path, float residentShare);
+		// switches the markets of all systems to call auctions
+		void setCallAuction(bool b);
+		size_t getResidentBytes() const;
+		size_t getPagedBytes() const;
+
+	private:
+		struct Shard;
+
+		void stepShard(unsigned int i);
+		void stepNetwork(unsigned int i);
+		void finishShard(unsigned int i);
+		void barrier();
+		void exportGoods(unsigned int i);
+		void touch(unsigned int i);
+		void deliver(const Shipment& s);
+		void measure(unsigned int i);
+		void pageIn(unsigned int i);
+		bool pageOut(unsigned int i);
+		void enforceBudget();
+
+		std::vector<SolarSystem*> mSystems;
+		std::vector<Shard*> mShards;
+		// time of the last physics update of each system
+		std::vector<double> mSystemTime;
+		double mTime = 0.0;
+		unsigned int mActive = 0;
+		// state of the current tick
+		bool mTicking = false;
+		unsigned int mTickActive = 0;
+		std::chrono::steady_clock::time_point mDeadline;
+		std::vector<std::function<void ()>> mTickTasks;
+		bool mAsync = false;
+		std::thread mTickThread;
+		std::atomic<bool> mTickFinished{false};
+		// price ranges are double buffered: shards read the ones
+		// published at the last barrier and write the other
+		unsigned int mPublished = 0;
+		ThreadPool mPool;
+		Pager* mPager = nullptr;
+		size_t mResidentBudget = 0;
+		unsigned long long mAccessCounter = 0;
+		unsigned int mNextMeasure = 0;
+};
+
+#endif
+
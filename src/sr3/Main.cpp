@@ -3,6 +3,7 @@
 #include <vector>
 #include <map>
 #include <cfloat>
+#include <chrono>
 
 #include <boost/shared_ptr.hpp>
 
@@ -11,157 +12,127 @@
 #include "common/FontConfig.h"
 #include "common/Math.h"
 #include "common/Entity.h"
-#include "common/Vehicle.h"
 #include "common/Steering.h"
 #include "common/Clock.h"
 
 #include "SolarObject.h"
+#include "SolarSystem.h"
+#include "Galaxy.h"
 #include "Settlement.h"
 #include "Constants.h"
 #include "Product.h"
 #include "Econ.h"
+#include "SlotMap.h"
+#include "ShipPhysics.h"
+#include "MarketQueues.h"
+#include "EconSnapshot.h"
+#include "WakeQueue.h"
+#include "CacheDir.h"
 
 
 using namespace Common;
 
 
-class TradeRoute {
-	public:
-		TradeRoute(SolarObject* from, SolarObject* to, const std::string& product);
-		SolarObject* getFrom() { return mFrom; }
-		SolarObject* getTo() { return mTo; }
-		const SolarObject* getFrom() const { return mFrom; }
-		const SolarObject* getTo() const { return mTo; }
-		const std::string& getProduct() const { return mProduct; }
-
-	private:
-		SolarObject* mFrom;
-		SolarObject* mTo;
-		std::string mProduct;
-};
-
-TradeRoute::TradeRoute(SolarObject* from, SolarObject* to, const std::string& product)
-	: mFrom(from),
-	mTo(to),
-	mProduct(product)
-{
-}
-
-
-class TradeNetwork {
-	public:
-		void addTradeRoute(SolarObject* from, SolarObject* to, const std::string& product);
-		void clearTradeRoutes();
-		std::vector<boost::shared_ptr<TradeRoute>>& getTradeRoutesFrom(const SolarObject* from);
-		const std::vector<boost::shared_ptr<TradeRoute>>& getTradeRoutesFrom(const SolarObject* from) const;
-		const std::map<const SolarObject*, std::vector<boost::shared_ptr<TradeRoute>>>& getTradeRoutes() const;
-
-	private:
-		std::map<const SolarObject*, std::vector<boost::shared_ptr<TradeRoute>>> mTradeRoutes;
-};
-
-void TradeNetwork::addTradeRoute(SolarObject* from, SolarObject* to, const std::string& product)
-{
-	mTradeRoutes[from].push_back(boost::shared_ptr<TradeRoute>(new TradeRoute(from, to, product)));
-}
-
-void TradeNetwork::clearTradeRoutes()
-{
-	mTradeRoutes.clear();
-}
-
-std::vector<boost::shared_ptr<TradeRoute>>& TradeNetwork::getTradeRoutesFrom(const SolarObject* from)
-{
-	static std::vector<boost::shared_ptr<TradeRoute>> empty;
-	auto it = mTradeRoutes.find(from);
-	return it == mTradeRoutes.end() ? empty : it->second;
-}
-
-const std::map<const SolarObject*, std::vector<boost::shared_ptr<TradeRoute>>>& TradeNetwork::getTradeRoutes() const
-{
-	return mTradeRoutes;
-}
-
-const std::vector<boost::shared_ptr<TradeRoute>>& TradeNetwork::getTradeRoutesFrom(const SolarObject* from) const
-{
-	static std::vector<boost::shared_ptr<TradeRoute>> empty;
-	auto it = mTradeRoutes.find(from);
-	return it == mTradeRoutes.end() ? empty : it->second;
-}
-
-class SolarSystem {
-	public:
-		SolarSystem();
-		~SolarSystem();
-		SolarSystem(const SolarSystem&) = delete;
-		SolarSystem(const SolarSystem&&) = delete;
-		SolarSystem& operator=(const SolarSystem&) & = delete;
-		SolarSystem& operator=(SolarSystem&&) & = delete;
-
-		const std::vector<SolarObject*>& getObjects() const;
-		void update(float time);
-		void updateSettlements();
-		TradeNetwork& getTradeNetwork() { return mTradeNetwork; }
-		const TradeNetwork& getTradeNetwork() const { return mTradeNetwork; }
-
-	private:
-		void updateTradeNetwork();
-		void foundNewSettlement(SolarObject* from);
-
-		std::vector<SolarObject*> mObjects;
-		TradeNetwork mTradeNetwork;
-};
-
-
 class SpaceShip;
 
+// The AI only runs when the ship has something to do: it returns the
+// time at which it wants to run next, which is the takeoff time while
+// landed and the next steering correction in flight. Times are in
+// seconds of game time.
+//
+// Landing only sells the cargo. Choosing the next trade is left to
+// plan(), which GameState runs within a time budget per frame; a ship
+// stays landed until it has been planned.
 class SpaceShipAI {
 	public:
-		SpaceShipAI();
-		void control(SpaceShip* ss, float time);
+		double control(SpaceShip* ss, double now);
+		bool needsPlan() const { return mPlanPending; }
+		// past its takeoff time and still waiting for plan()
+		bool isHeldUp(double now) const { return mPlanPending && mTakeoffTime <= now; }
+		void plan(SpaceShip* ss);
+		// time since the last trade
+		double getIdleTime(double now) const { return now - mLastTrade; }
+		// results of the trades queued in the last update
+		void tradesDone(const std::vector<MarketCommand>& commands, double now);
 
 	private:
 		void handleLanding(SpaceShip* ss);
 		float getPotentialRevenue(const TradeRoute& tr) const;
+		double steer(SpaceShip* ss, double now);
 
 		SolarObject* mTarget = nullptr;
-		Countdown mLandedTimer;
+		SolarObject* mLandedOn = nullptr;
+		bool mPlanPending = false;
+		double mTakeoffTime = 0.0;
 		boost::shared_ptr<TradeRoute> mTradeRoute;
 		SpaceShip* mSS = nullptr;
+		double mLastTrade = -1.0;
 };
 
-class SpaceShip : public Vehicle {
+// The physics state of a ship lives in the ShipPhysics of its ship map,
+// under the slot of the ship.
+class SpaceShip {
 	public:
-		SpaceShip(bool players, SolarSystem* s);
-		bool isAlive() const { return mAlive; }
-		void setAlive(bool b) { mAlive = b; }
+		SpaceShip(bool players, SolarSystem* s, ShipPhysics* physics, unsigned int slot);
+		~SpaceShip();
+		SpaceShip(const SpaceShip&) = delete;
+		SpaceShip(const SpaceShip&&) = delete;
+		SpaceShip& operator=(const SpaceShip&) & = delete;
+		SpaceShip& operator=(SpaceShip&&) & = delete;
+		bool isAlive() const { return mPhysics->isAlive(mSlot); }
+		void setAlive(bool b) { mPhysics->setAlive(mSlot, b); }
 		bool isPlayer() const { return mPlayers; }
-		virtual void update(float time) override;
+		// runs the AI and returns when it wants to run again, see
+		// SpaceShipAI; the ship is moved by ShipPhysics
+		double update(double now);
+		// see SpaceShipAI::plan()
+		bool needsPlan() const { return mAgent.needsPlan(); }
+		bool isHeldUp(double now) const { return mAgent.isHeldUp(now); }
+		void plan() { mAgent.plan(this); }
 		SolarSystem* getSystem() { return mSystem; }
 		const SolarSystem* getSystem() const { return mSystem; }
+		void setSystem(SolarSystem* s) { mSystem = s; }
 		bool canLand(const SolarObject& obj) const;
+		// how close the ship has to be to land on the object
+		float getLandingDistance(const SolarObject& obj) const;
 		bool landed() const;
 		void land(const SolarObject* obj);
 		void takeoff();
 		const SolarObject* getLandObject() const { return mLandObject; }
 		const SolarObject* getClosestObject(float* dist) const;
 		unsigned int getID() const { return mID; }
-		const Trader& getTrader() const { return mTrader; }
-		Trader& getTrader() { return mTrader; }
+		const ShipTrader& getTrader() const { return mTrader; }
+		ShipTrader& getTrader() { return mTrader; }
+		// AI traders that are broke or have not traded for a while
+		bool shouldDespawn(double now) const;
+		// Trades with markets are only queued during update(). GameState
+		// runs them afterwards and then calls tradesDone().
+		void queueTrade(SolarObject* obj, ProductId product, unsigned int number, bool sell);
+		std::vector<MarketCommand>& getMarketCommands() { return mCommands; }
+		void tradesDone(double now);
+
+		// landed ships are where the object they landed on is
+		Vector3 getPosition() const { return mLandObject ? mLandObject->getPosition() : mPhysics->getPosition(mSlot); }
+		void setPosition(const Vector3& v) { mPhysics->setPosition(mSlot, v); }
+		Vector3 getVelocity() const { return mPhysics->getVelocity(mSlot); }
+		float getXYRotation() const { return mPhysics->getRotation(mSlot); }
+		float getThrust() const { return mPhysics->getThrust(mSlot); }
+		void setThrust(float f) { mPhysics->setThrust(mSlot, f); }
+		float getSideThrust() const { return mPhysics->getSideThrust(mSlot); }
+		void setSideThrust(float f) { mPhysics->setSideThrust(mSlot, f); }
+		float getEnginePower() const { return mPhysics->getEnginePower(mSlot); }
 
 		float Scale = 10.0f;
-		float EnginePower = 1000.0f;
-		float Thrust = 0.0f;
-		float SidePower = 2.0f;
-		float SideThrust = 0.0f;
 		Color Color;
 
 	private:
-		bool mAlive = true;
 		bool mPlayers;
 		SpaceShipAI mAgent;
 		SolarSystem* mSystem;
-		Trader mTrader;
+		ShipPhysics* mPhysics;
+		unsigned int mSlot;
+		ShipTrader mTrader;
+		std::vector<MarketCommand> mCommands;
 		const SolarObject* mLandObject = nullptr;
 		unsigned int mID;
 		static unsigned int NextID;
@@ -169,55 +140,27 @@ class SpaceShip : public Vehicle {
 
 unsigned int SpaceShip::NextID = 0;
 
-SpaceShip::SpaceShip(bool players, SolarSystem* s)
-	: Vehicle(1.0f, 10000000.0f, 10000000.0f, true),
-	mPlayers(players),
+SpaceShip::SpaceShip(bool players, SolarSystem* s, ShipPhysics* physics, unsigned int slot)
+	: mPlayers(players),
 	mSystem(s),
-	mTrader(Constants::SpaceShipCargoSpace * 5.0f, Constants::SpaceShipCargoSpace),
+	mPhysics(physics),
+	mSlot(slot),
+	mTrader(Money::credits(Constants::SpaceShipCargoSpace * 5), Constants::SpaceShipCargoSpace),
 	mID(++NextID)
 {
 	Color = mPlayers ? Color::White : Color::Red;
+	mPhysics->add(mSlot, Constants::SpaceShipEnginePower, Constants::SpaceShipSidePower);
 }
 
-SpaceShipAI::SpaceShipAI()
-	: mLandedTimer(5.0f)
+SpaceShip::~SpaceShip()
 {
+	mPhysics->remove(mSlot);
 }
 
-void SpaceShip::update(float time)
+double SpaceShip::update(double now)
 {
-	if(isAlive() && !landed()) {
-		auto rot = getXYRotation();
-		auto th = Thrust;
-		Vector3 accel;
-
-		if(mSystem) {
-			th *= Constants::SolarSystemSpeedCoefficient;
-			for(const auto& obj : mSystem->getObjects()) {
-				auto dist = Entity::distanceBetween(*this, *obj);
-				if(dist) {
-					auto f = Entity::vectorFromTo(*this, *obj) * (1e+6 * obj->getMass() / (dist * dist));
-					assert(!isnan(f.x));
-					accel += f;
-				}
-			}
-		}
-
-		accel += Vector3(th * EnginePower * cos(rot),
-				th * EnginePower * sin(rot), 0.0f);
-
-		setAcceleration(accel);
-		setXYRotationalVelocity(SidePower * SideThrust);
-	}
-	if(!mPlayers) {
-		mAgent.control(this, time);
-	}
-
-	if(!landed()) {
-		Vehicle::update(time);
-	} else {
-		setPosition(mLandObject->getPosition());
-	}
+	assert(!mPlayers);
+	return mAgent.control(this, now);
 }
 
 bool SpaceShip::canLand(const SolarObject& obj) const
@@ -226,11 +169,8 @@ bool SpaceShip::canLand(const SolarObject& obj) const
 		return false;
 
 	// TODO: should actually check relative speed
-	// Make landing easier for the dumb AI
-	auto dist = Entity::distanceBetween(*this, obj);
-	auto maxDist = mPlayers ? std::max(0.5f, obj.getSize()) * Constants::PlanetSizeCoefficient + 500.0f :
-		std::max(1.0f, obj.getSize()) * Constants::PlanetSizeCoefficient + 2500.0f;
-	if(dist > maxDist) {
+	auto dist = getPosition().distance(obj.getPosition());
+	if(dist > getLandingDistance(obj)) {
 		return false;
 	} else if(mPlayers && getVelocity().length() > 10000.0f) {
 		return false;
@@ -239,6 +179,33 @@ bool SpaceShip::canLand(const SolarObject& obj) const
 	}
 }
 
+float SpaceShip::getLandingDistance(const SolarObject& obj) const
+{
+	// Make landing easier for the dumb AI
+	return mPlayers ? std::max(0.5f, obj.getSize()) * Constants::PlanetSizeCoefficient + 500.0f :
+		std::max(1.0f, obj.getSize()) * Constants::PlanetSizeCoefficient + 2500.0f;
+}
+
+bool SpaceShip::shouldDespawn(double now) const
+{
+	if(mPlayers)
+		return false;
+	bool broke = mTrader.getMoney() < Constants::TraderMinMoney &&
+		mTrader.storageLeft() == mTrader.getMaxCapacity();
+	return broke || mAgent.getIdleTime(now) > Constants::TraderIdleDespawnTime;
+}
+
+void SpaceShip::queueTrade(SolarObject* obj, ProductId product, unsigned int number, bool sell)
+{
+	mCommands.push_back(MarketCommand{obj, product, number, sell, 0});
+}
+
+void SpaceShip::tradesDone(double now)
+{
+	mAgent.tradesDone(mCommands, now);
+	mCommands.clear();
+}
+
 bool SpaceShip::landed() const
 {
 	return mLandObject != nullptr;
@@ -250,12 +217,15 @@ void SpaceShip::land(const SolarObject* obj)
 	assert(canLand(*obj));
 	assert(!mLandObject);
 	mLandObject = obj;
+	mPhysics->setFlying(mSlot, false);
 }
 
 void SpaceShip::takeoff()
 {
 	assert(mLandObject);
+	setPosition(mLandObject->getPosition());
 	mLandObject = nullptr;
+	mPhysics->setFlying(mSlot, true);
 }
 
 const SolarObject* SpaceShip::getClosestObject(float* dist) const
@@ -265,8 +235,9 @@ const SolarObject* SpaceShip::getClosestObject(float* dist) const
 	if(!mSystem)
 		return ret;
 
+	auto pos = getPosition();
 	for(const auto& so : mSystem->getObjects()) {
-		auto thisdist = Entity::distanceBetween(*this, *so);
+		auto thisdist = pos.distance(so->getPosition());
 		if(thisdist < mindist) {
 			ret = so;
 			mindist = thisdist;
@@ -310,200 +281,73 @@ bool LaserShot::testHit(const SpaceShip* other)
 }
 
 
-SolarSystem::SolarSystem()
-{
-	srand(21);
-	auto star = new SolarObject("Sol", 1.0f, 1.0f);
-	mObjects.push_back(star);
-	mObjects.push_back(new SolarObject(star, "Mercury", SOType::RockyNoAtmosphere, 0.5f, 0.5f, 0.4f, 3.0f, 0));
-	mObjects.push_back(new SolarObject(star, "Venus", SOType::RockyCarbonDioxide, 0.9f, 0.9f, 0.7f, 2.0f, 1));
-	auto p1 = new SolarObject(star, "Earth", SOType::RockyOxygen, 1.0f, 1.0f, 1.0f, 1.0f, 8);
-	auto m1 = new SolarObject(p1, "Moon", SOType::RockyNoAtmosphere, 0.4f, 0.2f, 0.1f, 3.0f, 3);
-	mObjects.push_back(p1);
-	mObjects.push_back(m1);
-	mObjects.push_back(new SolarObject(star, "Mars", SOType::RockyCarbonDioxide, 0.7f, 0.7f, 2.0f, 0.5f, 6));
-	auto p2 = new SolarObject(star, "Jupiter", SOType::GasGiant, 15.0f, 15.0f, 4.0f, 0.25f, 0);
-	auto m2 = new SolarObject(p2, "Io", SOType::RockyNoAtmosphere, 0.2f, 0.2f, 0.3f, 3.0f, 1);
-	auto m3 = new SolarObject(p2, "Europa", SOType::RockyNoAtmosphere, 0.2f, 0.2f, 0.4f, 3.0f, 1);
-	auto m4 = new SolarObject(p2, "Ganymede", SOType::RockyNoAtmosphere, 0.2f, 0.2f, 0.5f, 3.0f, 0);
-	auto m5 = new SolarObject(p2, "Callisto", SOType::RockyNoAtmosphere, 0.2f, 0.2f, 0.6f, 3.0f, 0);
-	mObjects.push_back(p2);
-	mObjects.push_back(m2);
-	mObjects.push_back(m3);
-	mObjects.push_back(m4);
-	mObjects.push_back(m5);
-	auto p3 = new SolarObject(star, "Saturn", SOType::GasGiant, 10.0f, 10.0f, 8.0f, 0.25f, 0);
-	auto m6 = new SolarObject(p3, "Dione", SOType::RockyNoAtmosphere, 0.2f, 0.2f, 0.3f, 2.0f, 0);
-	auto m7 = new SolarObject(p3, "Rhea", SOType::RockyNoAtmosphere, 0.2f, 0.2f, 0.4f, 2.0f, 0);
-	auto m8 = new SolarObject(p3, "Titan", SOType::RockyNoAtmosphere, 0.2f, 0.2f, 0.5f, 2.0f, 1);
-	auto m9 = new SolarObject(p3, "Iapetus", SOType::RockyNoAtmosphere, 0.2f, 0.2f, 0.6f, 2.0f, 0);
-	mObjects.push_back(p3);
-	mObjects.push_back(m6);
-	mObjects.push_back(m7);
-	mObjects.push_back(m8);
-	mObjects.push_back(m9);
-
-	updateTradeNetwork();
-}
 
-void SolarSystem::updateTradeNetwork()
+double SpaceShipAI::control(SpaceShip* ss, double now)
 {
-	mTradeNetwork.clearTradeRoutes();
-	const auto& products = ProductCatalog::getInstance()->getNames();
-
-	for(SolarObject* o : mObjects) {
-		if(!o->hasMarket())
-			continue;
-
-		const auto& m1 = o->getMarket();
-		const auto& stor = m1->getStorage();
-		for(SolarObject* o2 : mObjects) {
-			if(o == o2)
-				continue;
-
-			if(!o2->hasMarket())
-				continue;
-
-			const auto& m2 = o2->getMarket();
-			for(const auto& prod : products) {
-				auto it = stor.find(prod);
-				if(it != stor.end() && it->second > 0 &&
-						m2->getPrice(prod) > 1.5f * m1->getPrice(prod) &&
-						m2->getMoney() > m2->getPrice(prod)) {
-					mTradeNetwork.addTradeRoute(o, o2, prod);
-				}
-			}
-		}
-	}
-}
-
-void SolarSystem::updateSettlements()
-{
-	for(auto& obj : mObjects) {
-		if(obj->hasMarket()) {
-			bool newsett = obj->updateSettlement();
-			if(newsett) {
-				foundNewSettlement(obj);
-			}
-		}
-	}
-	updateTradeNetwork();
-}
-
-void SolarSystem::foundNewSettlement(SolarObject* from)
-{
-	SolarObject* target = nullptr;
-	auto maxHappiness = 0.0f;
-
-	auto popMigrating = from->getSettlement()->getPopulation() * Constants::PercentagePopulationColonised;
-
-	// pick object with highest happiness if any
-	for(auto& obj : mObjects) {
-		if(obj == from)
-			continue;
-
-		if(!obj->hasSettlement())
-			continue;
-
-		// ensure the target doesn't receive more immigrants than it can handle
-		auto migrateSpace = obj->getMaxPopulation() - obj->getSettlement()->getPopulation();
-		if(migrateSpace < popMigrating * 2)
-			continue;
-
-		auto hap = obj->getSettlementHappiness();
-		if(hap > 0.4f && hap > maxHappiness) {
-			target = obj;
-			maxHappiness = hap;
-		}
+	if(!mSS) {
+		mSS = ss;
+		mLastTrade = now;
+	} else {
+		assert(mSS == ss);
 	}
 
-	// if none found colonise a new object
-	if(!target) {
-		for(auto& obj : mObjects) {
-			if(obj == from)
-				continue;
-
-			if(!obj->canBeColonised())
-				continue;
-
-			if(!obj->hasSettlement()) {
-				target = obj;
-				break;
-			}
-		}
+	// the next wake-up must be later than now, so check again later
+	if(!ss->getSystem())
+		return now + Constants::ShipMaxSteerInterval;
+	if(ss->landed()) {
+		if(now < mTakeoffTime)
+			return mTakeoffTime;
+		// stay until the queued trades have run, they wait for the econ tick
+		if(mPlanPending || !ss->getMarketCommands().empty())
+			return now + Constants::ShipMinSteerInterval;
+		ss->takeoff();
 	}
-
-	if(target) {
-		from->colonise(target);
+	if(!mTarget) {
+		const auto& objs = ss->getSystem()->getObjects();
+		assert(objs.size() > 0);
+		int index = rand() % objs.size();
+		if(index == 0 && objs.size() > 1)
+			index++;
+		mTarget = objs[index];
 	}
+	return steer(ss, now);
 }
 
-SolarSystem::~SolarSystem()
+double SpaceShipAI::steer(SpaceShip* ss, double now)
 {
-	for(auto& o : mObjects)
-		delete o;
-}
+	auto desiredVelocity = mTarget->getPosition() - ss->getPosition();
+	auto velDiff = desiredVelocity - ss->getVelocity() * 2.5f;
+	velDiff = Math::rotate2D(velDiff, -ss->getXYRotation());
+	auto velDiffNorm = velDiff / (ss->getEnginePower() * Constants::SolarSystemSpeedCoefficient);
+	ss->setSideThrust(clamp(-1.0f, velDiffNorm.y, 1.0f));
+	ss->setThrust(clamp(-1.0f, velDiffNorm.x * 2.0f, 1.0f));
+
+	if(ss->canLand(*mTarget)) {
+		ss->land(mTarget);
+		handleLanding(ss); // resets mTarget
+		mTakeoffTime = now + Constants::ShipLandedTime;
+		return mTakeoffTime;
+	}
 
-const std::vector<SolarObject*>& SolarSystem::getObjects() const
-{
-	return mObjects;
+	// the thrust is kept until then, so look again well before arrival
+	auto dist = desiredVelocity.length() - ss->getLandingDistance(*mTarget);
+	auto speed = ss->getVelocity().length();
+	auto wait = speed > 0.0f ? 0.5f * dist / speed : Constants::ShipMaxSteerInterval;
+	return now + clamp(Constants::ShipMinSteerInterval, wait, Constants::ShipMaxSteerInterval);
 }
 
-void SolarSystem::update(float time)
+void SpaceShipAI::tradesDone(const std::vector<MarketCommand>& commands, double now)
 {
-	for(auto& o : mObjects) {
-		o->update(time);
-	}
-}
-
-void SpaceShipAI::control(SpaceShip* ss, float time)
-{
-	if(!mSS)
-		mSS = ss;
-	else
-		assert(mSS == ss);
-
-	if(ss->getSystem()) {
-		if(ss->landed()) {
-			if(mLandedTimer.countdownAndRewind(time)) {
-				ss->takeoff();
-			}
-		} else {
-			if(mTarget) {
-				auto desiredVelocity = mTarget->getPosition() - ss->getPosition();
-				auto velDiff = desiredVelocity - ss->getVelocity() * 2.5f;
-				velDiff = Math::rotate2D(velDiff, -ss->getXYRotation());
-				auto velDiffNorm = velDiff / (ss->EnginePower * Constants::SolarSystemSpeedCoefficient);
-				ss->SideThrust = clamp(-1.0f, velDiffNorm.y, 1.0f);
-				ss->Thrust = clamp(-1.0f, velDiffNorm.x * 2.0f, 1.0f);
-
-				if(ss->canLand(*mTarget)) {
-					ss->land(mTarget);
-					handleLanding(ss); // resets mTarget
-				}
-			} else {
-				const auto& objs = ss->getSystem()->getObjects();
-				assert(objs.size() > 0);
-				int index = rand() % objs.size();
-				if(index == 0 && objs.size() > 1)
-					index++;
-				mTarget = objs[index];
-			}
-		}
+	for(const auto& c : commands) {
+		if(c.Done)
+			mLastTrade = now;
 	}
 }
 
 float SpaceShipAI::getPotentialRevenue(const TradeRoute& tr) const
 {
 	assert(mSS);
-	auto from = tr.getFrom();
-	auto to = tr.getTo();
-	auto m1 = from->getMarket();
-	auto m2 = to->getMarket();
-	const auto& prod = tr.getProduct();
-	auto p1 = m1->getPrice(prod);
-	auto p2 = m2->getPrice(prod);
-	return (p2 - p1);
+	return mSS->getSystem()->getSnapshot()->getMargin(tr);
 }
 
 void SpaceShipAI::handleLanding(SpaceShip* ss)
@@ -512,23 +356,34 @@ void SpaceShipAI::handleLanding(SpaceShip* ss)
 	assert(mTarget == ss->getLandObject());
 	auto& trader = ss->getTrader();
 	auto landobj = mTarget;
+	// the econ tick may be running, so only read the snapshot
+	auto snapshot = ss->getSystem()->getSnapshot();
 
+	mLandedOn = mTarget;
 	mTarget = nullptr;
 	mTradeRoute = nullptr;
 
 	// always sell everything on arrival if possible
-	if(landobj->hasMarket()) {
-		for(auto it : trader.getStorage()) {
-			if(it.second) {
-				landobj->getMarket()->sell(it.first, it.second, trader, Econ::Entity::Trader, landobj);
-			}
-		}
+	if(snapshot->hasMarket(landobj)) {
+		trader.forEachItem([&] (ProductId id, unsigned int num) {
+				ss->queueTrade(landobj, id, num, true); });
 	}
+	mPlanPending = true;
+}
+
+void SpaceShipAI::plan(SpaceShip* ss)
+{
+	assert(mPlanPending);
+	assert(ss->landed() && mLandedOn == ss->getLandObject());
+	auto& trader = ss->getTrader();
+	auto landobj = mLandedOn;
+	auto snapshot = ss->getSystem()->getSnapshot();
+	mPlanPending = false;
 
 	// choose next trade
 	if(!mTradeRoute || landobj == mTradeRoute->getTo()) {
 		// prefer routes from current location, search all routes otherwise
-		auto& tn = ss->getSystem()->getTradeNetwork();
+		auto& tn = snapshot->getTradeNetwork();
 		auto routes = tn.getTradeRoutesFrom(landobj);
 		if(routes.size() == 0) {
 			const auto& routemap = tn.getTradeRoutes();
@@ -559,16 +414,16 @@ void SpaceShipAI::handleLanding(SpaceShip* ss)
 	}
 
 	// buy goods if planned
-	if(mTradeRoute && landobj == mTradeRoute->getFrom()) {
+	if(mTradeRoute && landobj == mTradeRoute->getFrom() && snapshot->hasMarket(landobj)) {
 		auto prod = mTradeRoute->getProduct();
-		assert(landobj->hasMarket());
-		landobj->getMarket()->buy(prod, trader.storageLeft(), trader, Econ::Entity::Trader, landobj);
+		// the cargo is only sold once the trades run, so ask for a full hold
+		ss->queueTrade(landobj, ProductCatalog::getInstance()->getId(prod), trader.getMaxCapacity(), false);
 		mTarget = mTradeRoute->getTo();
 
 #if 0
 		// if earned enough money, feed money back to the population of the exporting site
-		if(trader.getMoney() > 1000.0f) {
-			auto toDonate = trader.getMoney() - 1000.0f;
+		if(trader.getMoney() > Money::credits(1000)) {
+			auto toDonate = trader.getMoney() - Money::credits(1000);
 			trader.removeMoney(toDonate);
 			landobj->getSettlement()->getPopulationObj()->addMoney(toDonate);
 			printf("Donated %.2f to %s.\n", toDonate, landobj->getName().c_str());
@@ -580,69 +435,89 @@ void SpaceShipAI::handleLanding(SpaceShip* ss)
 
 class GameState {
 	public:
+		typedef SlotMap<SpaceShip> ShipMap;
+
 		GameState();
-		~GameState();
 		GameState(const GameState&) = delete;
 		GameState(const GameState&&) = delete;
 		GameState& operator=(const GameState&) & = delete;
 		GameState& operator=(GameState&&) & = delete;
 		SpaceShip* getPlayerShip();
 		const SpaceShip* getPlayerShip() const;
-		const std::vector<SpaceShip*>& getShips() const;
-		std::vector<SpaceShip*>& getShips();
+		const ShipMap& getShips() const;
+		ShipMap& getShips();
 		std::vector<LaserShot>& getShots();
-		const SolarSystem& getSolarSystem() const { return mSystem; }
+		const SolarSystem& getSolarSystem() const { return mGalaxy.getActiveSystem(); }
+		const Galaxy& getGalaxy() const { return mGalaxy; }
 		bool isSolar() { return mSolar; }
 		void update(float t);
 		void endCombat();
 		void shoot(SpaceShip* s);
+		void jump(unsigned int system);
 
 	private:
-		void spawnSolarShip();
-
-		std::vector<SpaceShip*> mCombatShips;
-		std::vector<SpaceShip*> mSolarShips;
+		SpaceShip* spawnSolarShip();
+		void despawnSolarShip(ShipMap::Handle h);
+		// runs the AI of the solar ships that are due
+		void wakeSolarShips();
+		// plans the landed solar ships until the frame's budget is spent
+		void planSolarShips();
+		// runs the trades the solar ships queued in their update
+		void runMarketCommands();
+
+		// declared before the ship maps so that they outlive the ships
+		ShipPhysics mCombatPhysics;
+		ShipPhysics mSolarPhysics;
+		ShipMap mCombatShips;
+		ShipMap mSolarShips;
+		ShipMap::Handle mCombatPlayer;
+		ShipMap::Handle mSolarPlayer;
 		std::vector<LaserShot> mShots;
 		bool mSolar = false;
-		SolarSystem mSystem;
+		Galaxy mGalaxy;
+		MarketQueues mMarketQueues;
+		// game time in seconds
+		double mTime = 0.0;
+		// the next AI update of each AI solar ship
+		WakeQueue<ShipMap::Handle> mSolarWakes;
+		// solar ships with queued trades
+		std::vector<ShipMap::Handle> mTradingShips;
+		// landed solar ships waiting for SpaceShipAI::plan()
+		std::vector<ShipMap::Handle> mPlanningShips;
 		SteadyTimer mSpawnSolarShipTimer;
 		SteadyTimer mUpdatePricesTimer;
 };
 
 GameState::GameState()
-	: mSpawnSolarShipTimer(0.8f),
+	: mGalaxy(Constants::NumGalaxySystems),
+	mSpawnSolarShipTimer(0.8f),
 	mUpdatePricesTimer(10.0f)
 {
 	// player
-	mCombatShips.push_back(new SpaceShip(true, nullptr));
+	mCombatPlayer = mCombatShips.emplace(true, nullptr, &mCombatPhysics, mCombatShips.nextIndex());
 	for(int i = 0; i < 3; i++) {
-		mCombatShips.push_back(new SpaceShip(false, nullptr));
-		mCombatShips[i + 1]->setPosition(Vector3(rand() % 100 - 50, rand() % 100 - 50, 0.0f));
+		auto h = mCombatShips.emplace(false, nullptr, &mCombatPhysics, mCombatShips.nextIndex());
+		mCombatShips.get(h)->setPosition(Vector3(rand() % 100 - 50, rand() % 100 - 50, 0.0f));
 	}
-	auto ss = new SpaceShip(true, &mSystem);
-	ss->setPosition(Vector3(20000.0f, 20000.0f, 0.0f));
-	mSolarShips.push_back(ss);
+	mSolarPlayer = mSolarShips.emplace(true, &mGalaxy.getActiveSystem(), &mSolarPhysics, mSolarShips.nextIndex());
+	mSolarShips.get(mSolarPlayer)->setPosition(Vector3(20000.0f, 20000.0f, 0.0f));
 	for(int i = 0; i < 5; i++)
 		spawnSolarShip();
-}
-
-GameState::~GameState()
-{
-	for(auto s : mCombatShips)
-		delete s;
-	for(auto s : mSolarShips)
-		delete s;
+	mGalaxy.setAsyncTick(Constants::AsyncEconTick);
+	if(!getCacheDir().empty())
+		mGalaxy.enablePaging(getCacheDir() + "galaxy.pages", Constants::ResidentStateShare);
 }
 
 void GameState::update(float t)
 {
+	mTime += t;
 	if(!mSolar) {
 		for(auto& ps : mCombatShips) {
 			for(auto it = mShots.begin(); it != mShots.end(); ) {
-				if(it->testHit(ps)) {
-					if(ps->isAlive()) {
+				if(it->testHit(&ps)) {
+					if(ps.isAlive()) {
 						it = mShots.erase(it);
-						ps->setAlive(false);
+						ps.setAlive(false);
 					} else {
 						++it;
 					}
@@ -650,35 +525,47 @@ void GameState::update(float t)
 					++it;
 				}
 			}
-			ps->update(t);
 		}
+		mCombatPhysics.accelerate(nullptr);
+		for(auto& ps : mCombatShips) {
+			if(!ps.isPlayer())
+				ps.update(mTime);
+		}
+		mCombatPhysics.integrate(t);
 
 		for(auto& ls : mShots) {
 			ls.update(t);
 		}
 	} else {
-		mSystem.update(t);
-		for(auto& ps : mSolarShips) {
-			ps->update(t);
-		}
+		mGalaxy.update(t);
+		mSolarPhysics.accelerate(&mGalaxy.getActiveSystem());
+		wakeSolarShips();
+		planSolarShips();
+		// while the econ tick runs the ships keep their trades queued and
+		// their cargo, which would go to the fleet of the system
+		if(!mGalaxy.isTicking())
+			runMarketCommands();
+		mSolarPhysics.integrate(t);
 
 		if(mSpawnSolarShipTimer.check(t)) {
-			if(getSolarSystem().getTradeNetwork().getTradeRoutes().size() * 20 < mSolarShips.size()) {
+			// only spawn traders while there is trade to do
+			auto maxShips = std::min(getSolarSystem().getSnapshot()->getTradeNetwork().getNumSources() * Constants::SolarShipsPerTradeSource,
+					Constants::MaxSolarShips);
+			if(mSolarShips.size() < maxShips) {
 				spawnSolarShip();
 			}
 		}
 
 		if(mUpdatePricesTimer.check(t)) {
-			mSystem.updateSettlements();
+			mGalaxy.beginTick();
 		}
+		mGalaxy.stepTick(Constants::EconTickBudget);
 	}
 }
 
 void GameState::endCombat()
 {
 	assert(!mSolar);
-	for(auto s : mCombatShips)
-		delete s;
 	mCombatShips.clear();
 	mShots.clear();
 	mSolar = true;
@@ -696,45 +583,186 @@ void GameState::shoot(SpaceShip* s)
 
 const SpaceShip* GameState::getPlayerShip() const
 {
-	if(!mSolar) {
-		assert(mCombatShips.size() > 0);
-		return mCombatShips[0];
-	} else {
-		assert(mSolarShips.size() > 0);
-		return mSolarShips[0];
-	}
+	auto ps = mSolar ? mSolarShips.get(mSolarPlayer) : mCombatShips.get(mCombatPlayer);
+	assert(ps);
+	return ps;
 }
 
 SpaceShip* GameState::getPlayerShip()
 {
-	if(!mSolar) {
-		assert(mCombatShips.size() > 0);
-		return mCombatShips[0];
-	} else {
-		assert(mSolarShips.size() > 0);
-		return mSolarShips[0];
-	}
+	auto ps = mSolar ? mSolarShips.get(mSolarPlayer) : mCombatShips.get(mCombatPlayer);
+	assert(ps);
+	return ps;
 }
 
-const std::vector<SpaceShip*>& GameState::getShips() const
+const GameState::ShipMap& GameState::getShips() const
 {
 	return mSolar ? mSolarShips : mCombatShips;
 }
 
-std::vector<SpaceShip*>& GameState::getShips()
+GameState::ShipMap& GameState::getShips()
 {
 	return mSolar ? mSolarShips : mCombatShips;
 }
 
-void GameState::spawnSolarShip()
+SpaceShip* GameState::spawnSolarShip()
 {
-	auto ss = new SpaceShip(false, &mSystem);
-	const auto& objs = mSystem.getObjects();
+	auto& system = mGalaxy.getActiveSystem();
+	auto h = mSolarShips.emplace(false, &system, &mSolarPhysics, mSolarShips.nextIndex());
+	auto ss = mSolarShips.get(h);
+	const auto& objs = system.getObjects();
 	assert(objs.size() > 0);
 	int index = rand() % objs.size();
 	const auto& obj = objs[index];
 	ss->setPosition(obj->getPosition());
-	mSolarShips.push_back(ss);
+	mSolarWakes.schedule(h, mTime);
+	return ss;
+}
+
+void GameState::wakeSolarShips()
+{
+	while(mSolarWakes.isDue(mTime)) {
+		auto h = mSolarWakes.pop();
+		auto ss = mSolarShips.get(h);
+		if(!ss)
+			continue; // despawned
+		// idle traders are only let go while no econ tick runs and
+		// once their trades have run
+		if(!mGalaxy.isTicking() && ss->getMarketCommands().empty() && ss->shouldDespawn(mTime)) {
+			despawnSolarShip(h);
+			continue;
+		}
+		bool trading = !ss->getMarketCommands().empty();
+		bool planning = ss->needsPlan();
+		auto next = ss->update(mTime);
+		assert(next > mTime);
+		mSolarWakes.schedule(h, next);
+		if(!trading && !ss->getMarketCommands().empty())
+			mTradingShips.push_back(h);
+		if(!planning && ss->needsPlan())
+			mPlanningShips.push_back(h);
+	}
+}
+
+void GameState::planSolarShips()
+{
+	if(mPlanningShips.empty())
+		return;
+	auto deadline = std::chrono::steady_clock::now() +
+		std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+				std::chrono::duration<double, std::milli>(Constants::AIPlanBudget));
+
+	// ships held up at their market first, then those closest to the player
+	mPlanningShips.erase(std::remove_if(mPlanningShips.begin(), mPlanningShips.end(),
+				[this] (const ShipMap::Handle& h) { return !mSolarShips.get(h); }),
+			mPlanningShips.end());
+	auto pos = getPlayerShip()->getPosition();
+	std::sort(mPlanningShips.begin(), mPlanningShips.end(),
+			[&] (const ShipMap::Handle& h1, const ShipMap::Handle& h2) {
+				auto s1 = mSolarShips.get(h1);
+				auto s2 = mSolarShips.get(h2);
+				bool held1 = s1->isHeldUp(mTime);
+				bool held2 = s2->isHeldUp(mTime);
+				if(held1 != held2)
+					return held1;
+				auto d1 = pos.distance(s1->getPosition());
+				auto d2 = pos.distance(s2->getPosition());
+				return d1 != d2 ? d1 < d2 : h1.Index < h2.Index;
+			});
+
+	// at least one ship per frame
+	unsigned int num = 0;
+	while(num < mPlanningShips.size()) {
+		auto h = mPlanningShips[num++];
+		auto ss = mSolarShips.get(h);
+		bool trading = !ss->getMarketCommands().empty();
+		ss->plan();
+		if(!trading && !ss->getMarketCommands().empty())
+			mTradingShips.push_back(h);
+		if(std::chrono::steady_clock::now() >= deadline)
+			break;
+	}
+	mPlanningShips.erase(mPlanningShips.begin(), mPlanningShips.begin() + num);
+}
+
+void GameState::runMarketCommands()
+{
+	// slot order makes the order of the trades at each market deterministic
+	std::sort(mTradingShips.begin(), mTradingShips.end(),
+			[] (const ShipMap::Handle& h1, const ShipMap::Handle& h2) { return h1.Index < h2.Index; });
+	for(auto h : mTradingShips) {
+		auto ss = mSolarShips.get(h);
+		assert(ss);
+		mMarketQueues.add(ss->getTrader(), ss->getMarketCommands());
+	}
+	mMarketQueues.apply();
+	for(auto h : mTradingShips) {
+		auto ss = mSolarShips.get(h);
+		ss->tradesDone(mTime);
+		// broke after the trades
+		if(ss->shouldDespawn(mTime))
+			despawnSolarShip(h);
+	}
+	mTradingShips.clear();
+}
+
+void GameState::despawnSolarShip(ShipMap::Handle h)
+{
+	// the money and cargo go to the aggregate fleet of the system
+	auto& fleet = mGalaxy.getActiveSystem().getFleetTrader();
+	auto& t = mSolarShips.get(h)->getTrader();
+	if(t.getMoney() > Money())
+		fleet.addMoney(t.getMoney());
+	t.forEachItem([&] (ProductId id, unsigned int num) {
+			fleet.addToStorage(id, num); });
+	mSolarShips.erase(h);
+}
+
+void GameState::jump(unsigned int system)
+{
+	assert(mSolar);
+	auto ps = getPlayerShip();
+	assert(!ps->landed());
+	mGalaxy.stepTick(-1.0);
+	runMarketCommands();
+
+	// fold the AI traders of the old system into its aggregate fleet
+	auto& oldSystem = mGalaxy.getActiveSystem();
+	unsigned int numFolded = 0;
+	for(auto it = mSolarShips.begin(); it != mSolarShips.end(); ++it) {
+		if(it.handle() == mSolarPlayer)
+			continue;
+		despawnSolarShip(it.handle());
+		numFolded++;
+	}
+	mSolarWakes.clear();
+	mPlanningShips.clear();
+	oldSystem.setFleetSize(numFolded);
+
+	mGalaxy.setActiveSystem(system);
+	auto& newSystem = mGalaxy.getActiveSystem();
+	ps->setSystem(&newSystem);
+
+	// spawn the aggregate fleet of the new system as ships
+	auto& newFleet = newSystem.getFleetTrader();
+	auto num = std::min(newSystem.getFleetSize(), Constants::MaxSolarShips - 1);
+	auto moneyPerShip = num ? newFleet.getMoney() / num : Money();
+	for(unsigned int i = 0; i < num; i++) {
+		auto& t = spawnSolarShip()->getTrader();
+		t.removeMoney(t.getMoney());
+		auto share = i + 1 == num ? newFleet.getMoney() : moneyPerShip;
+		if(share > Money()) {
+			newFleet.removeMoney(share);
+			t.addMoney(share);
+		}
+		newFleet.forEachItem([&] (ProductId id, unsigned int num) {
+				auto added = t.addToStorage(id, num);
+				newFleet.removeFromStorage(id, added); });
+	}
+	// cargo that did not fit in the spawned ships stays with the fleet,
+	// which the despawned ships of this system add to as well
+	newSystem.setFleetSize(0);
+	printf("Jumped to system %u.\n", system);
 }
 
 
@@ -811,9 +839,10 @@ bool AppDriver::init()
 
 std::string AppDriver::getPopulationString(const SolarObject& obj) const
 {
-	assert(obj.hasMarket());
+	auto settlement = mGameState.getSolarSystem().getSnapshot()->getSettlement(&obj);
+	assert(settlement);
 	char buf[256];
-	auto pop = obj.getSettlement()->getPopulation();
+	auto pop = settlement->getPopulation();
 	snprintf(buf, 255, "%u", pop);
 	return std::string(buf);
 }
@@ -825,25 +854,28 @@ void AppDriver::drawMarket()
 	assert(ps->landed());
 	const auto* obj = ps->getLandObject();
 	assert(obj);
-	if(obj->hasMarket()) {
-		const auto* m = obj->getMarket();
+	auto snapshot = mGameState.getSolarSystem().getSnapshot();
+	if(snapshot->hasMarket(obj)) {
+		const auto* m = snapshot->getMarket(obj);
 		assert(m);
-		const auto& stor = m->getStorage();
 		char buf[256];
 		snprintf(buf, 255, "%s", obj->getName().c_str());
 		text.push_back(std::string(buf));
 
 		auto popstr = getPopulationString(*obj);
 		snprintf(buf, 255, "Population of %s with %.2f credits", 
-				popstr.c_str(), obj->getSettlement()->getPopulationMoney());
+				popstr.c_str(), snapshot->getSettlement(obj)->getPopulationMoney().toCredits());
 		text.push_back(std::string(buf));
 		snprintf(buf, 255, "%-20s %-10s %-10s", "Product", "Quantity", "Price");
 		text.push_back(std::string(buf));
-		for(const auto& st : stor) {
-			snprintf(buf, 255, "%-20s %-10d %-10.2f", st.first.c_str(), st.second, m->getPrice(st.first));
+		auto catalog = ProductCatalog::getInstance();
+		for(ProductId id = 0; id <= catalog->getNumProducts(); id++) {
+			if(!m->isListed(id))
+				continue;
+			snprintf(buf, 255, "%-20s %-10d %-10.2f", catalog->getName(id).c_str(), m->items(id), m->getPrice(id));
 			text.push_back(std::string(buf));
 		}
-		snprintf(buf, 255, "Ship storage %d      %.2f credits", ps->getTrader().storageLeft(), ps->getTrader().getMoney());
+		snprintf(buf, 255, "Ship storage %d      %.2f credits", ps->getTrader().storageLeft(), ps->getTrader().getMoney().toCredits());
 		text.push_back(std::string(buf));
 	} else {
 		text.push_back("No market. Press space to exit.");
@@ -893,17 +925,17 @@ void AppDriver::drawSpace()
 	Vector3 trdiff(width * 0.5f - mCamera.x * mZoom, height * 0.5f - mCamera.y * mZoom, 0.0f);
 
 	for(const auto& ps : mGameState.getShips()) {
-		if(ps->landed())
+		if(ps.landed())
 			continue;
 		glPushMatrix();
-		if(ps->isAlive())
-			glColor4ub(ps->Color.r, ps->Color.g, ps->Color.b, 255);
+		if(ps.isAlive())
+			glColor4ub(ps.Color.r, ps.Color.g, ps.Color.b, 255);
 		else
 			glColor4ub(50, 0, 0, 255);
-		auto tr = ps->getPosition() * mZoom + trdiff;
+		auto tr = ps.getPosition() * mZoom + trdiff;
 		glTranslatef(tr.x, tr.y, 0.0f);
-		glRotatef(Math::radiansToDegrees(ps->getXYRotation()), 0.0f, 0.0f, 1.0f);
-		float sc = ps->Scale * pow(mZoom, 0.1f);
+		glRotatef(Math::radiansToDegrees(ps.getXYRotation()), 0.0f, 0.0f, 1.0f);
+		float sc = ps.Scale * pow(mZoom, 0.1f);
 		glScalef(sc, sc, 1.0f);
 		glBegin(GL_TRIANGLES);
 		glVertex2f( 1.0f,  0.0f);
@@ -914,16 +946,16 @@ void AppDriver::drawSpace()
 		// thrusters
 		glLineWidth(2.0f);
 		glColor3f(0.5f, 0.5f, 1.0f);
-		if(ps->Thrust) {
+		if(ps.getThrust()) {
 			glBegin(GL_LINES);
 			glVertex2f(0.0f, 0.0f);
-			glVertex2f(-ps->Thrust * 2.0f, 0.0f);
+			glVertex2f(-ps.getThrust() * 2.0f, 0.0f);
 			glEnd();
 		}
-		if(ps->SideThrust) {
+		if(ps.getSideThrust()) {
 			glBegin(GL_LINES);
 			glVertex2f(0.0f, 0.0f);
-			glVertex2f(0.0f, -ps->SideThrust * 1.0f);
+			glVertex2f(0.0f, -ps.getSideThrust() * 1.0f);
 			glEnd();
 		}
 		glLineWidth(1.0f);
@@ -1131,18 +1163,33 @@ bool AppDriver::handleKeyUp(float frameTime, SDLKey key)
 
 void AppDriver::printInfo()
 {
-	for(auto ss : mGameState.getShips()) {
-		auto t = ss->getTrader();
+	auto catalog = ProductCatalog::getInstance();
+	auto snapshot = mGameState.getSolarSystem().getSnapshot();
+	for(const auto& ss : mGameState.getShips()) {
+		const auto& t = ss.getTrader();
 		printf("Spaceship %3u, %.2f money, %3d space.\n",
-				ss->getID(), t.getMoney(), t.storageLeft());
-		for(const auto& it : t.getStorage()) {
-			if(it.second)
-				printf("\t%-20s %-3u\n", it.first.c_str(), it.second);
-		}
+				ss.getID(), t.getMoney().toCredits(), t.storageLeft());
+		t.forEachItem([&] (ProductId id, unsigned int num) {
+				printf("\t%-20s %-3u\n", catalog->getName(id).c_str(), num); });
 	}
 
-	auto products = ProductCatalog::getInstance()->getNames();
-	products.push_back("Labour");
+	// with a large catalog, only show the goods stocked somewhere in the system
+	std::vector<bool> stocked(catalog->getNumProducts() + 1, false);
+	stocked[catalog->getLabourId()] = true;
+	for(const auto& obj : mGameState.getSolarSystem().getObjects()) {
+		if(!snapshot->hasMarket(obj))
+			continue;
+		const auto* m = snapshot->getMarket(obj);
+		for(ProductId id = 0; id < stocked.size(); id++) {
+			if(m->items(id))
+				stocked[id] = true;
+		}
+	}
+	std::vector<std::string> products;
+	for(ProductId id = 0; id < stocked.size(); id++) {
+		if(stocked[id])
+			products.push_back(catalog->getName(id));
+	}
 	printf("%-12s %-16s %-16s %-16s %-12s ", "System", "Population", "Pop money", "Market money", "Happiness");
 	for(auto& p : products) {
 		printf("%-16s ", p.c_str());
@@ -1152,19 +1199,19 @@ void AppDriver::printInfo()
 	unsigned long long totalPeople = 0;
 	unsigned long long totalHappyPeople = 0;
 	for(const auto& obj : mGameState.getSolarSystem().getObjects()) {
-		if(!obj->hasMarket())
+		if(!snapshot->hasMarket(obj))
 			continue;
 
 		printf("%-12s %-16s %-16.2f %-16.2f %-12.2f ", obj->getName().c_str(),
 				getPopulationString(*obj).c_str(),
-				obj->getSettlement()->getPopulationMoney(), obj->getMarket()->getMoney(),
-				obj->getSettlementHappiness());
+				snapshot->getSettlement(obj)->getPopulationMoney().toCredits(), snapshot->getMarket(obj)->getMoney().toCredits(),
+				snapshot->getSettlement(obj)->getHappiness());
 
-		auto pop = obj->getSettlement()->getPopulation();
+		auto pop = snapshot->getSettlement(obj)->getPopulation();
 		totalPeople += pop;
-		totalHappyPeople += pop * obj->getSettlementHappiness();
+		totalHappyPeople += pop * snapshot->getSettlement(obj)->getHappiness();
 
-		const auto& m = obj->getMarket();
+		const auto& m = snapshot->getMarket(obj);
 		for(auto& p : products) {
 			auto items = m->items(p);
 			auto price = m->getPrice(p);
@@ -1193,7 +1240,7 @@ void AppDriver::printInfo()
 	printf("%-16s %-16s %-16s %-16s %-16s %-16s\n", "Object", "Product", "Production", "Consumption", "Import", "Export");
 	for(auto prod : products) {
 		for(const auto& obj : mGameState.getSolarSystem().getObjects()) {
-			if(obj->hasMarket()) {
+			if(snapshot->hasMarket(obj)) {
 				auto dt = Econ::Stats::getInstance()->getData(obj, prod);
 				printf("%-16s %-16s %-16u %-16u %-16u %-16u\n", obj->getName().c_str(),
 						prod.c_str(), dt.Production, dt.Consumption,
@@ -1204,20 +1251,20 @@ void AppDriver::printInfo()
 	Econ::Stats::getInstance()->clearData();
 
 	for(const auto& obj : mGameState.getSolarSystem().getObjects()) {
-		if(obj->hasMarket()) {
-			for(auto it : obj->getSettlement()->getProducers()) {
-				printf("%-10s %-3u %s\n", obj->getName().c_str(), it.second->getLevel(), it.first.c_str());
+		if(snapshot->hasMarket(obj)) {
+			for(const auto& p : snapshot->getSettlement(obj)->getProducers()) {
+				printf("%-10s %-3u %s\n", obj->getName().c_str(), p.getLevel(), p.getProduct().c_str());
 			}
 		}
 	}
 
 	{
 		unsigned int numRoutes = 0;
-		for(auto it : mGameState.getSolarSystem().getTradeNetwork().getTradeRoutes()) {
+		for(auto it : snapshot->getTradeNetwork().getTradeRoutes()) {
 			numRoutes += it.second.size();
 		}
 		if(numRoutes <= 5) {
-			for(auto it : mGameState.getSolarSystem().getTradeNetwork().getTradeRoutes()) {
+			for(auto it : snapshot->getTradeNetwork().getTradeRoutes()) {
 				for(auto it2 : it.second) {
 					printf("Trade route from %-20s to %-20s for %-20s\n",
 							it2->getFrom()->getName().c_str(),
@@ -1229,6 +1276,35 @@ void AppDriver::printInfo()
 			printf("%zd trade routes.\n", numRoutes);
 		}
 	}
+
+	// the worker writes the stats and timelines while a tick is running
+	const auto& galaxy = mGameState.getGalaxy();
+	if(galaxy.isTicking()) {
+		printf("Econ tick running, no stats.\n");
+	} else {
+		printf("Econ tick on %u threads:\n", galaxy.getNumThreads());
+		for(unsigned int i = 0; i < galaxy.getNumSystems(); i++) {
+			const auto& st = galaxy.getShardStats(i);
+			printf("System %3u: tick %8.3f ms, barrier wait %8.3f ms\n", i, st.TickTime, st.BarrierWait);
+		}
+
+		// stages that overlap ran on different cores
+		printf("Stage timeline of the last tick in ms:\n%-10s", "System");
+		for(unsigned int j = 0; j < NumEconStages; j++)
+			printf(" %-15s", EconTimeline::getName(EconStage(j)));
+		printf("\n");
+		for(unsigned int i = 0; i < galaxy.getNumSystems(); i++) {
+			const auto& tl = galaxy.getSystem(i).getTimeline();
+			printf("%-10u", i);
+			for(unsigned int j = 0; j < NumEconStages; j++) {
+				if(tl.Start[j] < 0.0)
+					printf(" %-15s", "-");
+				else
+					printf(" %6.3f-%-8.3f", tl.Start[j], tl.End[j]);
+			}
+			printf("\n");
+		}
+	}
 }
 
 bool AppDriver::handleSpaceKey(SDLKey key, bool down)
@@ -1243,7 +1319,7 @@ bool AppDriver::handleSpaceKey(SDLKey key, bool down)
 				acc = 1.0f;
 			else
 				acc = 0.0f;
-			ps->Thrust = acc;
+			ps->setThrust(acc);
 			break;
 
 		case SDLK_s:
@@ -1251,7 +1327,7 @@ bool AppDriver::handleSpaceKey(SDLKey key, bool down)
 				acc = -1.0f;
 			else
 				acc = 0.0f;
-			ps->Thrust = acc;
+			ps->setThrust(acc);
 			break;
 
 		case SDLK_a:
@@ -1259,7 +1335,7 @@ bool AppDriver::handleSpaceKey(SDLKey key, bool down)
 				side = 1.0f;
 			else
 				side = 0.0f;
-			ps->SideThrust = side;
+			ps->setSideThrust(side);
 			break;
 
 		case SDLK_d:
@@ -1267,7 +1343,7 @@ bool AppDriver::handleSpaceKey(SDLKey key, bool down)
 				side = -1.0f;
 			else
 				side = 0.0f;
-			ps->SideThrust = side;
+			ps->setSideThrust(side);
 			break;
 
 		case SDLK_PLUS:
@@ -1308,6 +1384,14 @@ bool AppDriver::handleSpaceKey(SDLKey key, bool down)
 			}
 			break;
 
+		case SDLK_j:
+			if(down && mState == AppDriverState::SolarSystem && !ps->landed()) {
+				auto next = (mGameState.getGalaxy().getActiveSystemIndex() + 1) %
+					mGameState.getGalaxy().getNumSystems();
+				mGameState.jump(next);
+			}
+			break;
+
 		case SDLK_F1:
 			if(down)
 				printInfo();
@@ -1382,12 +1466,12 @@ bool AppDriver::checkCombat()
 	int numNearbyOpponents = 0;
 	const auto& ps = mGameState.getPlayerShip();
 	for(const auto& ss : mGameState.getShips()) {
-		if(ss->isPlayer())
+		if(ss.isPlayer())
 			continue;
 
-		if(ss->isAlive()) {
+		if(ss.isAlive()) {
 			numOpponents++;
-			if(Entity::distanceBetween(*ps, *ss) < 500.0f)
+			if(ps->getPosition().distance(ss.getPosition()) < 500.0f)
 				numNearbyOpponents++;
 		}
 	}
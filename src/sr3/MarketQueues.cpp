@@ -0,0 +1,33 @@
+#include <cassert>
+
+#include "MarketQueues.h"
+#include "SolarObject.h"
+
+void MarketQueues::add(ShipTrader& trader, std::vector<MarketCommand>& commands)
+{
+	for(auto& c : commands) {
+		// the settlement may have been abandoned since the ship landed
+		if(!c.Object->hasMarket())
+			continue;
+		auto i = c.Object->getSettlementIndex();
+		if(i >= mQueues.size())
+			mQueues.resize(i + 1);
+		mQueues[i].push_back(Entry{&trader, &c});
+	}
+}
+
+void MarketQueues::apply()
+{
+	for(auto& q : mQueues) {
+		for(auto& e : q) {
+			auto c = e.Command;
+			auto m = c->Object->getMarket();
+			if(c->Sell)
+				c->Done = m->sell(c->Product, c->Number, *e.Trader, Econ::Entity::Trader, c->Object);
+			else
+				c->Done = m->buy(c->Product, c->Number, *e.Trader, Econ::Entity::Trader, c->Object);
+		}
+		q.clear();
+	}
+}
+
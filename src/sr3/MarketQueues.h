@@ -0,0 +1,45 @@
+#ifndef SR3_MARKETQUEUES_H
+#define SR3_MARKETQUEUES_H
+
+#include <vector>
+
+#include "Settlement.h"
+
+class SolarObject;
+
+// A buy or sell that a trader wants to make at a market.
+struct MarketCommand {
+	SolarObject* Object;
+	ProductId Product;
+	// for buys, at most what fits in the hold once the commands before
+	// this one have run
+	unsigned int Number;
+	bool Sell;
+	// items traded, set by MarketQueues::apply()
+	unsigned int Done;
+};
+
+// Trades of ships with the markets of a solar system. While ships are
+// updated they only add commands to their own list, so no market is
+// touched and the updates of different ships do not share any state.
+// The lists are then queued per market and applied at one point of the
+// frame, market by market in the order the lists were added.
+class MarketQueues {
+	public:
+		// commands of one trader run in list order; the list must stay
+		// in place until apply()
+		void add(ShipTrader& trader, std::vector<MarketCommand>& commands);
+		void apply();
+
+	private:
+		struct Entry {
+			ShipTrader* Trader;
+			MarketCommand* Command;
+		};
+
+		// indexed by the settlement of the market
+		std::vector<std::vector<Entry>> mQueues;
+};
+
+#endif
+
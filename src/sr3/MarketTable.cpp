@@ -0,0 +1,261 @@
+#include <cassert>
+#include <algorithm>
+#include <cmath>
+
+#include "MarketTable.h"
+#include "Econ.h"
+#include "Constants.h"
+#include "StateBuffer.h"
+
+namespace {
+	// weight of the latest tick in the volatility average
+	const float VolatilityWeight = 0.2f;
+
+	// the factor of one price step from a uniform random number
+	float stepFactor(float u)
+	{
+		return 1.10f + u * 0.1f;
+	}
+
+	// Price rule for one product row. A traded, listed product gets
+	// cheaper by its factor if the market had a surplus and dearer, up
+	// to Constants::MaxPrice, if it ran out of stock. The relative price
+	// change and the number of listed products are added up per market
+	// for the volatility. The loop has no branches and the arrays are
+	// marked as not overlapping so that it can be vectorised. This also
+	// needs -fno-trapping-math, see CMakeLists.txt.
+	void updateRow(unsigned int n, float* __restrict price,
+			const unsigned int* __restrict stock, const int* __restrict surplus,
+			const unsigned char* __restrict traded, const unsigned char* __restrict listed,
+			const float* __restrict factor, float* __restrict change, float* __restrict numListed)
+	{
+		for(unsigned int i = 0; i < n; i++) {
+			float p = price[i];
+			float f = factor[i];
+			float down = p / f;
+			down = down < 0.01f ? 0.01f : down;
+			float up = p * f;
+			up = up > Constants::MaxPrice ? Constants::MaxPrice : up;
+			up = stock[i] == 0 ? up : p;
+			float np = surplus[i] > 0 ? down : up;
+			np = (traded[i] & listed[i]) ? np : p;
+			price[i] = np;
+			change[i] += listed[i] ? std::fabs(np - p) / p : 0.0f;
+			numListed[i] += listed[i] ? 1.0f : 0.0f;
+		}
+	}
+
+	// copies the columns of a row-major array into a wider one
+	template<typename T>
+	std::vector<T> widen(const std::vector<T>& v, unsigned int rows, unsigned int columns,
+			unsigned int oldStride, unsigned int newStride)
+	{
+		std::vector<T> n(rows * newStride);
+		for(unsigned int r = 0; r < rows; r++)
+			std::copy_n(v.begin() + r * oldStride, columns, n.begin() + r * newStride);
+		return n;
+	}
+}
+
+// 0 is never used, so it can mark a value that was never computed
+std::atomic<uint64_t> MarketTable::NextEpoch(1);
+
+unsigned int MarketTable::addColumn()
+{
+	if(mRows == 0)
+		mRows = ProductCatalog::getInstance()->getNumProducts() + 1;
+	unsigned int m;
+	if(!mFree.empty()) {
+		m = mFree.back();
+		mFree.pop_back();
+	} else {
+		if(mNumColumns == mStride)
+			relayout(std::max(mStride * 2, 16u));
+		m = mNumColumns++;
+	}
+	resetColumn(m);
+	renewEpoch();
+	return m;
+}
+
+void MarketTable::freeColumn(unsigned int m)
+{
+	assert(m < mNumColumns);
+	// a free column has nothing traded or listed, so the price update
+	// leaves it alone
+	resetColumn(m);
+	mFree.push_back(m);
+	renewEpoch();
+}
+
+void MarketTable::resetColumn(unsigned int m)
+{
+	for(ProductId p = 0; p < mRows; p++) {
+		price(p, m) = 1.0f;
+		stock(p, m) = 0;
+		surplus(p, m) = 0;
+		traded(p, m) = 0;
+		listed(p, m) = 0;
+	}
+	mForeignTrade[m] = 0;
+	mPriceSteps[m] = 1;
+	mVolatility[m] = 0.0f;
+}
+
+void MarketTable::copyColumn(unsigned int to, const MarketTable& from, unsigned int fromColumn)
+{
+	assert(to < mNumColumns && fromColumn < from.mNumColumns && mRows == from.mRows);
+	for(ProductId p = 0; p < mRows; p++) {
+		auto i = p * mStride + to;
+		auto j = p * from.mStride + fromColumn;
+		mPrices[i] = from.mPrices[j];
+		mStock[i] = from.mStock[j];
+		mSurplus[i] = from.mSurplus[j];
+		mTraded[i] = from.mTraded[j];
+		mListed[i] = from.mListed[j];
+	}
+	mForeignTrade[to] = from.mForeignTrade[fromColumn];
+	mPriceSteps[to] = from.mPriceSteps[fromColumn];
+	mVolatility[to] = from.mVolatility[fromColumn];
+	renewEpoch();
+}
+
+void MarketTable::relayout(unsigned int stride)
+{
+	// all arrays are allocated before any is replaced, so running out of
+	// memory leaves the table as it was
+	auto prices = widen(mPrices, mRows, mNumColumns, mStride, stride);
+	auto stock = widen(mStock, mRows, mNumColumns, mStride, stride);
+	auto surplus = widen(mSurplus, mRows, mNumColumns, mStride, stride);
+	auto traded = widen(mTraded, mRows, mNumColumns, mStride, stride);
+	auto listed = widen(mListed, mRows, mNumColumns, mStride, stride);
+	auto foreign = widen(mForeignTrade, 1, mNumColumns, mStride, stride);
+	auto steps = widen(mPriceSteps, 1, mNumColumns, mStride, stride);
+	auto volatility = widen(mVolatility, 1, mNumColumns, mStride, stride);
+	mFactors.resize(stride);
+	mChange.resize(stride);
+	mNumListed.resize(stride);
+	mPrices.swap(prices);
+	mStock.swap(stock);
+	mSurplus.swap(surplus);
+	mTraded.swap(traded);
+	mListed.swap(listed);
+	mForeignTrade.swap(foreign);
+	mPriceSteps.swap(steps);
+	mVolatility.swap(volatility);
+	mStride = stride;
+}
+
+void MarketTable::updatePrices()
+{
+	auto labour = ProductCatalog::getInstance()->getLabourId();
+	mBatched.clear();
+	for(unsigned int m = 0; m < mNumColumns; m++) {
+		if(mPriceSteps[m] > 1)
+			mBatched.push_back(m);
+	}
+	std::fill_n(mChange.begin(), mNumColumns, 0.0f);
+	std::fill_n(mNumListed.begin(), mNumColumns, 0.0f);
+	for(ProductId p = 0; p < mRows; p++) {
+		auto row = p * mStride;
+		if(p == labour) {
+			for(unsigned int m = 0; m < mNumColumns; m++)
+				assert(mStock[row + m] == 0);
+		}
+		Econ::uniforms(mFactors.data(), mNumColumns);
+		for(unsigned int m = 0; m < mNumColumns; m++)
+			mFactors[m] = stepFactor(mFactors[m]);
+		for(auto m : mBatched)
+			mFactors[m] = batchFactor(mFactors[m], mPriceSteps[m]);
+		updateRow(mNumColumns, &mPrices[row], &mStock[row], &mSurplus[row],
+				&mTraded[row], &mListed[row], mFactors.data(), mChange.data(), mNumListed.data());
+	}
+	std::fill(mSurplus.begin(), mSurplus.end(), 0);
+	std::fill(mTraded.begin(), mTraded.end(), 0);
+	std::fill(mForeignTrade.begin(), mForeignTrade.end(), 0);
+	for(unsigned int m = 0; m < mNumColumns; m++)
+		finishPeriod(m);
+	renewEpoch();
+}
+
+void MarketTable::updatePrices(unsigned int m)
+{
+	assert(m < mNumColumns);
+	mChange[m] = 0.0f;
+	mNumListed[m] = 0.0f;
+	for(ProductId p = 0; p < mRows; p++) {
+		auto i = p * mStride + m;
+		float f = batchFactor(stepFactor(Econ::uniform()), mPriceSteps[m]);
+		updateRow(1, &mPrices[i], &mStock[i], &mSurplus[i],
+				&mTraded[i], &mListed[i], &f, &mChange[m], &mNumListed[m]);
+		mSurplus[i] = 0;
+		mTraded[i] = 0;
+	}
+	mForeignTrade[m] = 0;
+	finishPeriod(m);
+	renewEpoch();
+}
+
+float MarketTable::batchFactor(float f, unsigned int steps)
+{
+	// a step of its own for each tick, with a draw of its own
+	for(unsigned int k = 1; k < steps; k++)
+		f *= stepFactor(Econ::uniform());
+	return f;
+}
+
+void MarketTable::finishPeriod(unsigned int m)
+{
+	float change = mNumListed[m] > 0.0f ? mChange[m] / mNumListed[m] : 0.0f;
+	mVolatility[m] += VolatilityWeight * (change - mVolatility[m]);
+	mPriceSteps[m] = 1;
+}
+
+void MarketTable::saveColumn(StateWriter& w, unsigned int m) const
+{
+	for(ProductId p = 0; p < mRows; p++) {
+		auto i = p * mStride + m;
+		w.write(mPrices[i]);
+		w.write(mStock[i]);
+		w.write(mSurplus[i]);
+		w.write(mTraded[i]);
+		w.write(mListed[i]);
+	}
+	w.write(mPriceSteps[m]);
+	w.write(mVolatility[m]);
+}
+
+void MarketTable::loadColumn(StateReader& r, unsigned int m)
+{
+	for(ProductId p = 0; p < mRows; p++) {
+		auto i = p * mStride + m;
+		r.read(mPrices[i]);
+		r.read(mStock[i]);
+		r.read(mSurplus[i]);
+		r.read(mTraded[i]);
+		r.read(mListed[i]);
+	}
+	r.read(mPriceSteps[m]);
+	r.read(mVolatility[m]);
+	renewEpoch();
+}
+
+void MarketTable::clear()
+{
+	mStride = 0;
+	mNumColumns = 0;
+	std::vector<float>().swap(mPrices);
+	std::vector<unsigned int>().swap(mStock);
+	std::vector<int>().swap(mSurplus);
+	std::vector<unsigned char>().swap(mTraded);
+	std::vector<unsigned char>().swap(mListed);
+	std::vector<unsigned char>().swap(mForeignTrade);
+	std::vector<unsigned int>().swap(mPriceSteps);
+	std::vector<float>().swap(mVolatility);
+	std::vector<float>().swap(mFactors);
+	std::vector<float>().swap(mChange);
+	std::vector<float>().swap(mNumListed);
+	std::vector<unsigned int>().swap(mBatched);
+	std::vector<unsigned int>().swap(mFree);
+}
+
@@ -0,0 +1,105 @@
+#ifndef SR3_MARKETTABLE_H
+#define SR3_MARKETTABLE_H
+
+#include <vector>
+#include <atomic>
+#include <cstdint>
+
+#include "Product.h"
+
+class StateWriter;
+class StateReader;
+
+// The prices and stock of a set of markets, kept as one array per field
+// with a row per product and a column per market. This lets the price
+// update of all markets run as one pass over each row. Markets refer to
+// their column by index; adding a column may move the arrays.
+class MarketTable {
+	public:
+		MarketTable() = default;
+		MarketTable(const MarketTable&) = delete;
+		MarketTable(const MarketTable&&) = delete;
+		MarketTable& operator=(const MarketTable&) & = delete;
+		MarketTable& operator=(MarketTable&&) & = delete;
+
+		// adds a market with all prices at 1 and nothing in stock, in the
+		// last freed column if there is one
+		unsigned int addColumn();
+		// resets a column and keeps it for the next addColumn()
+		void freeColumn(unsigned int m);
+		// copies the state of a market from another table
+		void copyColumn(unsigned int to, const MarketTable& from, unsigned int fromColumn);
+		unsigned int getNumColumns() const { return mNumColumns; }
+		// Changes whenever prices in the table may have changed. Epochs are
+		// unique across all tables, so values derived from prices can be
+		// cached together with the epoch they were computed in.
+		uint64_t getEpoch() const { return mEpoch; }
+
+		float& price(ProductId p, unsigned int m) { return mPrices[p * mStride + m]; }
+		float price(ProductId p, unsigned int m) const { return mPrices[p * mStride + m]; }
+		unsigned int& stock(ProductId p, unsigned int m) { return mStock[p * mStride + m]; }
+		unsigned int stock(ProductId p, unsigned int m) const { return mStock[p * mStride + m]; }
+		int& surplus(ProductId p, unsigned int m) { return mSurplus[p * mStride + m]; }
+		// products bought or sold since the last price update
+		unsigned char& traded(ProductId p, unsigned int m) { return mTraded[p * mStride + m]; }
+		// whether a ship or a fleet traded in the market since the last
+		// price update, as opposed to its own settlement; not saved
+		bool hadForeignTrade(unsigned int m) const { return mForeignTrade[m]; }
+		void markForeignTrade(unsigned int m) { mForeignTrade[m] = 1; }
+		// products the market has ever had in stock; only these get prices
+		unsigned char& listed(ProductId p, unsigned int m) { return mListed[p * mStride + m]; }
+		unsigned char listed(ProductId p, unsigned int m) const { return mListed[p * mStride + m]; }
+
+		// Updates the prices of all markets from their trade since the
+		// last update and starts a new trade period.
+		void updatePrices();
+		// the same for one market
+		void updatePrices(unsigned int m);
+		// The trade since the last price update stands for this many
+		// ticks, so the prices traded step as often, each by a factor of
+		// its own but all in the direction of the combined trade. Reset
+		// to 1 by the price update.
+		void setPriceSteps(unsigned int m, unsigned int steps) { mPriceSteps[m] = steps; }
+		// Moving average over the price updates of the mean relative
+		// change of the listed prices of a market. A market whose listed
+		// prices all step on every update settles between 0.09 and 0.2.
+		float getVolatility(unsigned int m) const { return mVolatility[m]; }
+
+		void saveColumn(StateWriter& w, unsigned int m) const;
+		void loadColumn(StateReader& r, unsigned int m);
+		// removes all markets and frees the arrays
+		void clear();
+
+	private:
+		void resetColumn(unsigned int m);
+		void relayout(unsigned int stride);
+		static float batchFactor(float f, unsigned int steps);
+		void finishPeriod(unsigned int m);
+		void renewEpoch() { mEpoch = NextEpoch++; }
+
+		unsigned int mRows = 0;
+		unsigned int mStride = 0;
+		unsigned int mNumColumns = 0;
+		uint64_t mEpoch = NextEpoch++;
+		std::vector<float> mPrices;
+		std::vector<unsigned int> mStock;
+		std::vector<int> mSurplus;
+		std::vector<unsigned char> mTraded;
+		std::vector<unsigned char> mListed;
+		// by column
+		std::vector<unsigned char> mForeignTrade;
+		std::vector<unsigned int> mPriceSteps;
+		std::vector<float> mVolatility;
+		// scratch of the price update: the factors of one row, the sums
+		// for the volatility by column and the columns with several steps
+		std::vector<float> mFactors;
+		std::vector<float> mChange;
+		std::vector<float> mNumListed;
+		std::vector<unsigned int> mBatched;
+		std::vector<unsigned int> mFree;
+
+		static std::atomic<uint64_t> NextEpoch;
+};
+
+#endif
+
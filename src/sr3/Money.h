@@ -0,0 +1,83 @@
+#ifndef SR3_MONEY_H
+#define SR3_MONEY_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <climits>
+
+// An amount of credits as a fixed-point integer of Money::Scale units
+// per credit. Sums and products are exact, so money is conserved across
+// trades whatever the compiler does with floats. An amount that does not
+// fit would silently break that, so it aborts the game, in release
+// builds as well.
+class Money {
+	public:
+		static const int64_t Scale = 10000;
+
+		constexpr Money() : mUnits(0) { }
+		static constexpr Money credits(int64_t c) { return Money(c * Scale); }
+		static constexpr Money units(int64_t u) { return Money(u); }
+		// rounds to the nearest unit
+		static Money fromCredits(double c)
+		{
+			double u = c * Scale;
+			// also fails for NaN
+			check(std::fabs(u) < 9.0e18);
+			return Money(std::llround(u));
+		}
+		// what a trader with infinite funds has
+		static constexpr Money max() { return Money(INT64_MAX); }
+
+		int64_t getUnits() const { return mUnits; }
+		double toCredits() const { return mUnits / double(Scale); }
+
+		Money operator+(Money m) const
+		{
+			int64_t r;
+			check(!__builtin_add_overflow(mUnits, m.mUnits, &r));
+			return Money(r);
+		}
+		Money operator-(Money m) const
+		{
+			int64_t r;
+			check(!__builtin_sub_overflow(mUnits, m.mUnits, &r));
+			return Money(r);
+		}
+		Money operator*(unsigned int n) const
+		{
+			int64_t r;
+			check(!__builtin_mul_overflow(mUnits, int64_t(n), &r));
+			return Money(r);
+		}
+		Money operator/(unsigned int n) const { check(n); return Money(mUnits / int64_t(n)); }
+		// how many times m fits in this amount
+		int64_t operator/(Money m) const { check(m.mUnits > 0); return mUnits / m.mUnits; }
+		// the given fraction of this amount, rounded to the nearest unit
+		Money scale(double f) const { return fromCredits(toCredits() * f); }
+		Money& operator+=(Money m) & { return *this = *this + m; }
+		Money& operator-=(Money m) & { return *this = *this - m; }
+
+		bool operator==(Money m) const { return mUnits == m.mUnits; }
+		bool operator!=(Money m) const { return mUnits != m.mUnits; }
+		bool operator<(Money m) const { return mUnits < m.mUnits; }
+		bool operator<=(Money m) const { return mUnits <= m.mUnits; }
+		bool operator>(Money m) const { return mUnits > m.mUnits; }
+		bool operator>=(Money m) const { return mUnits >= m.mUnits; }
+
+	private:
+		explicit constexpr Money(int64_t u) : mUnits(u) { }
+		static void check(bool ok)
+		{
+			if(!ok) {
+				fprintf(stderr, "Money: amount out of range\n");
+				abort();
+			}
+		}
+
+		int64_t mUnits;
+};
+
+#endif
+
@@ -0,0 +1,136 @@
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "Pager.h"
+
+Pager::Pager(const std::string& path)
+	: mPath(path)
+{
+	mFd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if(mFd < 0) {
+		perror("Pager: open");
+		return;
+	}
+	if(!grow(1024 * 1024)) {
+		close(mFd);
+		mFd = -1;
+	}
+}
+
+Pager::~Pager()
+{
+	if(mMap)
+		munmap(mMap, mMapSize);
+	if(mFd >= 0) {
+		close(mFd);
+		unlink(mPath.c_str());
+	}
+}
+
+bool Pager::grow(size_t minSize)
+{
+	auto newSize = mMapSize ? mMapSize : minSize;
+	while(newSize < minSize)
+		newSize *= 2;
+
+	if(ftruncate(mFd, newSize) != 0) {
+		perror("Pager: ftruncate");
+		return false;
+	}
+	if(mMap)
+		munmap(mMap, mMapSize);
+	auto p = mmap(nullptr, newSize, PROT_READ | PROT_WRITE, MAP_SHARED, mFd, 0);
+	if(p == MAP_FAILED) {
+		perror("Pager: mmap");
+		mMap = nullptr;
+		mMapSize = 0;
+		return false;
+	}
+	mMap = static_cast<char*>(p);
+	mMapSize = newSize;
+	return true;
+}
+
+int Pager::store(const char* data, size_t len)
+{
+	if(!mMap)
+		return -1;
+
+	Range r = { 0, len };
+	bool found = false;
+	for(auto it = mFreeRanges.begin(); it != mFreeRanges.end(); ++it) {
+		if(it->Size >= len) {
+			r.Offset = it->Offset;
+			it->Offset += len;
+			it->Size -= len;
+			if(it->Size == 0)
+				mFreeRanges.erase(it);
+			found = true;
+			break;
+		}
+	}
+
+	if(!found) {
+		if(mEnd + len > mMapSize && !grow(mEnd + len))
+			return -1;
+		r.Offset = mEnd;
+		mEnd += len;
+	}
+
+	memcpy(mMap + r.Offset, data, len);
+	mStored += len;
+
+	int handle;
+	if(!mFreeHandles.empty()) {
+		handle = mFreeHandles.back();
+		mFreeHandles.pop_back();
+		mBlocks[handle] = r;
+	} else {
+		handle = mBlocks.size();
+		mBlocks.push_back(r);
+	}
+	return handle;
+}
+
+const char* Pager::get(int handle, size_t* len) const
+{
+	assert(handle >= 0 && handle < (int)mBlocks.size());
+	const auto& r = mBlocks[handle];
+	if(len)
+		*len = r.Size;
+	return mMap + r.Offset;
+}
+
+void Pager::release(int handle)
+{
+	assert(handle >= 0 && handle < (int)mBlocks.size());
+	auto r = mBlocks[handle];
+	mStored -= r.Size;
+	mFreeHandles.push_back(handle);
+	if(!r.Size)
+		return;
+
+	// keep the free ranges sorted and merged with their neighbours
+	auto it = mFreeRanges.begin();
+	while(it != mFreeRanges.end() && it->Offset < r.Offset)
+		++it;
+	it = mFreeRanges.insert(it, r);
+	if(it + 1 != mFreeRanges.end() && it->Offset + it->Size == (it + 1)->Offset) {
+		it->Size += (it + 1)->Size;
+		mFreeRanges.erase(it + 1);
+	}
+	if(it != mFreeRanges.begin() && (it - 1)->Offset + (it - 1)->Size == it->Offset) {
+		(it - 1)->Size += it->Size;
+		it = mFreeRanges.erase(it) - 1;
+	}
+	if(it->Offset + it->Size == mEnd) {
+		mEnd = it->Offset;
+		mFreeRanges.erase(it);
+	}
+}
+
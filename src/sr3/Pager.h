@@ -0,0 +1,45 @@
+#ifndef SR3_PAGER_H
+#define SR3_PAGER_H
+
+#include <string>
+#include <vector>
+
+// Backing store for evicted state. Every stored block is kept in one
+// contiguous range of a memory-mapped file that grows as needed.
+class Pager {
+	public:
+		Pager(const std::string& path);
+		~Pager();
+		Pager(const Pager&) = delete;
+		Pager(const Pager&&) = delete;
+		Pager& operator=(const Pager&) & = delete;
+		Pager& operator=(Pager&&) & = delete;
+
+		bool isOpen() const { return mMap != nullptr; }
+		// returns a handle to the stored block, or -1 on failure
+		int store(const char* data, size_t len);
+		const char* get(int handle, size_t* len) const;
+		void release(int handle);
+		size_t getStoredBytes() const { return mStored; }
+
+	private:
+		struct Range {
+			size_t Offset;
+			size_t Size;
+		};
+
+		bool grow(size_t minSize);
+
+		std::string mPath;
+		int mFd = -1;
+		char* mMap = nullptr;
+		size_t mMapSize = 0;
+		size_t mEnd = 0;
+		size_t mStored = 0;
+		std::vector<Range> mBlocks;
+		std::vector<int> mFreeHandles;
+		std::vector<Range> mFreeRanges;
+};
+
+#endif
+
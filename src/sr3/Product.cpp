@@ -1,144 +1,300 @@
+#include <cassert>
 #include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "Product.h"
+#include "CatalogFile.h"
+#include "CacheDir.h"
 #include "SolarObject.h"
 
-ProductParameter::ProductParameter(float value)
-	: mBaseValue(value)
+ProductCatalog* ProductCatalog::getInstance()
 {
+	static ProductCatalog Instance;
+	return &Instance;
 }
 
-float ProductParameter::getValue(const SolarObject& obj) const
+#ifdef SR3_STATIC_CATALOG
+ProductCatalog::ProductCatalog()
 {
-	auto it = mOverrideValue.find(obj.getType());
-	if(it == mOverrideValue.end())
-		return mBaseValue;
-	else
-		return it->second;
+	initNames(std::vector<std::string>(StaticCatalog::Names, StaticCatalog::Names + StaticCatalog::NumProducts),
+			StaticCatalog::Staple);
 }
 
-void ProductParameter::setOverrideValue(SOType t, float value)
+ProductCatalog::~ProductCatalog()
 {
-	mOverrideValue[t] = value;
 }
+#else
+namespace {
+	const char* CatalogPath = "share/products.txt";
+	const char* CacheName = "products.cache";
+	// bump whenever the header or the table layout changes
+	const unsigned int CacheVersion = 2;
 
+	// The cache file is this header followed by the tables in the order
+	// consumption, production cap, area factor, recipe start, recipe inputs
+	// and finally the product names, each terminated by '\0'. The source
+	// is identified by its size and an FNV-1a hash of its contents.
+	struct CacheHeader {
+		char Magic[4];
+		uint32_t Version;
+		uint32_t NumProducts;
+		uint32_t NumTypes;
+		uint32_t NumRecipeInputs;
+		uint32_t NamesSize;
+		uint32_t Staple;
+		uint32_t Padding;
+		uint64_t SourceSize;
+		uint64_t SourceHash;
+	};
 
-Product::Product(const std::string& name, float consumption, float labourreq, float areafactor, float productioncap)
-	: mName(name)
-{
-	mParameters.insert({"consumption", ProductParameter(consumption)});
-	mParameters.insert({"productionCap", ProductParameter(productioncap)});
-	mParameters.insert({"areaFactor", ProductParameter(areafactor)});
+	static_assert(sizeof(CacheHeader) % 4 == 0, "cache tables must stay aligned");
+	static_assert(sizeof(RecipeInput) == 8, "unexpected RecipeInput layout");
 
-	mGoodsRequired.insert({"Labour", ProductParameter(labourreq)});
-}
+	size_t tableSize(const CacheHeader& h)
+	{
+		size_t cells = h.NumProducts * h.NumTypes;
+		return sizeof(CacheHeader) + cells * 3 * sizeof(float) +
+			(cells + 1) * sizeof(unsigned int) +
+			h.NumRecipeInputs * sizeof(RecipeInput) + h.NamesSize;
+	}
 
-const std::string& Product::getName() const
-{
-	return mName;
+	bool getSourceStamp(const std::string& path, uint64_t& size, uint64_t& hash)
+	{
+		FILE* f = fopen(path.c_str(), "rb");
+		if(!f)
+			return false;
+		size = 0;
+		hash = 14695981039346656037ull;
+		char buf[4096];
+		size_t len;
+		while((len = fread(buf, 1, sizeof(buf), f)) > 0) {
+			for(size_t i = 0; i < len; i++) {
+				hash ^= (unsigned char)buf[i];
+				hash *= 1099511628211ull;
+			}
+			size += len;
+		}
+		bool ok = !ferror(f);
+		fclose(f);
+		return ok;
+	}
 }
 
-float Product::getConsumption(const SolarObject& obj) const
+ProductCatalog::ProductCatalog()
 {
-	return mParameters.at("consumption").getValue(obj);
-}
+	const auto& cacheDir = getCacheDir();
+	auto cachePath = cacheDir + CacheName;
+	if(!cacheDir.empty() && mapCache(cachePath, CatalogPath))
+		return;
 
-float Product::getLabourRequired(const SolarObject& obj) const
-{
-	return getGoodRequired("Labour", obj);
+	CatalogDefinition def;
+	std::string error;
+	if(!parseCatalogFile(CatalogPath, def, error) || !validateCatalog(def, error)) {
+		fprintf(stderr, "Product catalog: %s\n", error.c_str());
+		exit(1);
+	}
+	compile(def, CatalogPath);
+	if(!cacheDir.empty())
+		writeCache(cachePath);
 }
 
-float Product::getGoodRequired(const std::string& name, const SolarObject& obj) const
+ProductCatalog::~ProductCatalog()
 {
-	return mGoodsRequired.at(name).getValue(obj);
+	if(mCacheMap)
+		munmap(mCacheMap, mCacheSize);
 }
 
-float Product::getMaxProduction(const SolarObject& obj) const
+bool ProductCatalog::mapCache(const std::string& path, const std::string& source)
 {
-	auto cap = mParameters.at("productionCap").getValue(obj);
-	auto areaFactor = mParameters.at("areaFactor").getValue(obj);
-	if(areaFactor < 0.0f)
-		return cap;
-	auto area = obj.getArea();
-	return std::min(cap, areaFactor * area);
-}
+	uint64_t size;
+	uint64_t hash;
+	if(!getSourceStamp(source, size, hash))
+		return false;
 
-void Product::setOverrideValue(const std::string& name, SOType t, float value)
-{
-	mParameters.at(name).setOverrideValue(t, value);
+	int fd = open(path.c_str(), O_RDONLY);
+	if(fd < 0)
+		return false;
+	struct stat st;
+	if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(CacheHeader)) {
+		close(fd);
+		return false;
+	}
+	auto p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(p == MAP_FAILED)
+		return false;
+
+	auto h = static_cast<const CacheHeader*>(p);
+	if(memcmp(h->Magic, "SR3C", 4) || h->Version != CacheVersion ||
+			h->SourceSize != size || h->SourceHash != hash ||
+			!attach(static_cast<const char*>(p), st.st_size)) {
+		munmap(p, st.st_size);
+		return false;
+	}
+	mCacheMap = p;
+	mCacheSize = st.st_size;
+	return true;
 }
 
-void Product::setGoodRequirement(const std::string& name, float value)
+void ProductCatalog::writeCache(const std::string& path) const
 {
-	mGoodsRequired.insert({name, value});
+	// write to a temporary file first so that a partial cache is never mapped
+	auto tmpPath = path + ".tmp";
+	FILE* f = fopen(tmpPath.c_str(), "wb");
+	if(!f) {
+		perror("Product catalog: cache");
+		return;
+	}
+	bool ok = fwrite(mCompiled.data(), 1, mCompiled.size(), f) == mCompiled.size();
+	ok = fclose(f) == 0 && ok;
+	if(!ok || rename(tmpPath.c_str(), path.c_str()) != 0) {
+		perror("Product catalog: cache");
+		unlink(tmpPath.c_str());
+	}
 }
 
-std::vector<std::string> Product::getRequiredGoods(const SolarObject& obj) const
+void ProductCatalog::compile(const CatalogDefinition& def, const std::string& source)
 {
-	std::vector<std::string> ret;
-	for(auto it : mGoodsRequired)
-		ret.push_back(it.first);
-	return ret;
+	CompiledCatalog c;
+	compileCatalog(def, c);
+
+	std::string nameData;
+	for(const auto& name : c.Names) {
+		nameData += name;
+		nameData.push_back('\0');
+	}
+
+	CacheHeader h;
+	memcpy(h.Magic, "SR3C", 4);
+	h.Version = CacheVersion;
+	h.NumProducts = c.Names.size();
+	h.NumTypes = NumSOTypes;
+	h.NumRecipeInputs = c.RecipeInputs.size();
+	h.NamesSize = nameData.size();
+	h.Staple = c.Staple;
+	h.Padding = 0;
+	if(!getSourceStamp(source, h.SourceSize, h.SourceHash)) {
+		h.SourceSize = 0;
+		h.SourceHash = 0;
+	}
+
+	mCompiled.resize(tableSize(h));
+	char* p = mCompiled.data();
+	auto append = [&](const void* src, size_t len) {
+		memcpy(p, src, len);
+		p += len;
+	};
+	append(&h, sizeof(h));
+	append(c.Consumption.data(), c.Consumption.size() * sizeof(float));
+	append(c.ProductionCap.data(), c.ProductionCap.size() * sizeof(float));
+	append(c.AreaFactor.data(), c.AreaFactor.size() * sizeof(float));
+	append(c.RecipeStart.data(), c.RecipeStart.size() * sizeof(unsigned int));
+	append(c.RecipeInputs.data(), c.RecipeInputs.size() * sizeof(RecipeInput));
+	append(nameData.data(), nameData.size());
+
+	bool ok = attach(mCompiled.data(), mCompiled.size());
+	assert(ok);
 }
 
-float Product::getRequiredGoodQuantity(const std::string& reqGood, const SolarObject& obj) const
+bool ProductCatalog::attach(const char* data, size_t size)
 {
-	auto it = mGoodsRequired.find(reqGood);
-	if(it == mGoodsRequired.end())
-		return 0.0f;
-	return it->second.getValue(obj);
-}
+	const auto& h = *reinterpret_cast<const CacheHeader*>(data);
+	if(h.NumTypes != NumSOTypes || h.NumProducts == 0 || tableSize(h) != size)
+		return false;
 
+	std::vector<std::string> names;
+	const char* name = data + size - h.NamesSize;
+	const char* end = data + size;
+	while(name < end) {
+		auto len = strnlen(name, end - name);
+		if(name + len == end)
+			return false;
+		names.push_back(std::string(name, len));
+		name += len + 1;
+	}
+	if(names.size() != h.NumProducts || h.Staple >= h.NumProducts)
+		return false;
 
-ProductCatalog* ProductCatalog::getInstance()
-{
-	static ProductCatalog Instance;
-	return &Instance;
+	auto cells = h.NumProducts * NumSOTypes;
+	auto p = data + sizeof(CacheHeader);
+	mConsumption = reinterpret_cast<const float*>(p);
+	mProductionCap = mConsumption + cells;
+	mAreaFactor = mProductionCap + cells;
+	mRecipeStart = reinterpret_cast<const unsigned int*>(mAreaFactor + cells);
+	mRecipeInputs = reinterpret_cast<const RecipeInput*>(mRecipeStart + cells + 1);
+	if(mRecipeStart[cells] != h.NumRecipeInputs)
+		return false;
+	for(unsigned int i = 0; i < cells; i++) {
+		if(mRecipeStart[i] > mRecipeStart[i + 1])
+			return false;
+	}
+	for(unsigned int i = 0; i < h.NumRecipeInputs; i++) {
+		if(mRecipeInputs[i].Good > h.NumProducts)
+			return false;
+	}
+
+	mStaple = h.Staple;
+	initNames(names, h.Staple);
+	return true;
 }
+#endif
 
-ProductCatalog::ProductCatalog()
+void ProductCatalog::initNames(const std::vector<std::string>& names, ProductId staple)
 {
-	//                                           name               demd  lab   area factor prod cap
-	mProducts.insert({"Fruit",           Product("Fruit",           0.1f, 0.1f, 1000000.0f, 0.0f)});
-	mProducts.insert({"Luxury goods",    Product("Luxury goods",    0.3f, 9.0f, -1.0f,      1000000.0f)});
-	mProducts.insert({"Precious metals", Product("Precious metals", 0.0f, 0.3f, 10000.0f,   0.0f)});
+	mNames = names;
+	mIdNames = names;
+	mIdNames.push_back("Labour");
+	mIds.clear();
+	for(ProductId i = 0; i < mIdNames.size(); i++)
+		mIds[mIdNames[i]] = i;
 
-	mProducts.at("Fruit").setOverrideValue("productionCap", SOType::RockyOxygen, 1000000.0f);
-	mProducts.at("Precious metals").setOverrideValue("productionCap", SOType::RockyNoAtmosphere, 1000000.0f);
+	for(unsigned int t = 0; t < NumSOTypes; t++) {
+		mLuxuries[t].clear();
+		for(ProductId id = 0; id < mNames.size(); id++) {
+			if(id != staple && getConsumption(id, SOType(t)) > 0.0f)
+				mLuxuries[t].push_back(id);
+		}
+	}
+}
 
-	mProducts.at("Luxury goods").setGoodRequirement("Precious metals", 0.2f);
+ProductId ProductCatalog::getId(const std::string& prod) const
+{
+	return mIds.at(prod);
+}
 
-	for(auto it : mProducts) {
-		mNames.push_back(it.first);
+float ProductCatalog::getLabourRequired(ProductId prod, SOType t) const
+{
+	for(const auto& in : getRecipe(prod, t)) {
+		if(in.Good == getLabourId())
+			return in.Quantity;
 	}
+	return 0.0f;
 }
 
 float ProductCatalog::getConsumption(const std::string& prod, const SolarObject& obj) const
 {
-	return mProducts.at(prod).getConsumption(obj);
+	return getConsumption(getId(prod), obj.getType());
 }
 
 float ProductCatalog::getLabourRequired(const std::string& prod, const SolarObject& obj) const
 {
-	return mProducts.at(prod).getLabourRequired(obj);
+	return getLabourRequired(getId(prod), obj.getType());
 }
 
 float ProductCatalog::getMaxProduction(const std::string& prod, const SolarObject& obj) const
 {
-	return mProducts.at(prod).getMaxProduction(obj);
+	return getMaxProduction(getId(prod), obj.getType(), obj.getArea());
 }
 
 const std::vector<std::string>& ProductCatalog::getNames() const
 {
 	return mNames;
 }
-
-std::map<std::string, float> ProductCatalog::getRequiredGoods(const std::string& prod, const SolarObject& obj) const
-{
-	std::map<std::string, float> ret;
-	for(const auto& reqGood : mProducts.at(prod).getRequiredGoods(obj)) {
-		ret[reqGood] = mProducts.at(prod).getRequiredGoodQuantity(reqGood, obj);
-	}
-	return ret;
-}
-
@@ -4,45 +4,42 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <algorithm>
+#include <array>
 
 #include "Constants.h"
 
 class SolarObject;
+struct CatalogDefinition;
 
-class ProductParameter {
-	public:
-		ProductParameter(float value);
-		float getValue(const SolarObject& obj) const;
-		void setOverrideValue(SOType t, float value);
+typedef unsigned int ProductId;
 
-	private:
-		float mBaseValue;
-		std::map<SOType, float> mOverrideValue;
+struct RecipeInput {
+	ProductId Good;
+	float Quantity;
 };
 
-class Product {
-	public:
-		Product(const std::string& name, float consumption, float labourreq, float areafactor, float productioncap);
-
-		// getters
-		const std::string& getName() const;
-		float getConsumption(const SolarObject& obj) const;
-		float getLabourRequired(const SolarObject& obj) const;
-		float getGoodRequired(const std::string& name, const SolarObject& obj) const;
-		float getMaxProduction(const SolarObject& obj) const;
-		std::vector<std::string> getRequiredGoods(const SolarObject& obj) const;
-		float getRequiredGoodQuantity(const std::string& reqGood, const SolarObject& obj) const;
-
-		// setters
-		void setOverrideValue(const std::string& name, SOType t, float value);
-		void setGoodRequirement(const std::string& name, float value);
-
-	private:
-		std::map<std::string, ProductParameter> mParameters;
-		std::map<std::string, ProductParameter> mGoodsRequired;
-		std::string mName;
+// view of the input goods needed to produce one unit of a product
+struct Recipe {
+	const RecipeInput* First;
+	unsigned int Size;
+	const RecipeInput* begin() const { return First; }
+	const RecipeInput* end() const { return First + Size; }
 };
 
+#ifdef SR3_STATIC_CATALOG
+// generated by catalogc from share/products.txt
+#include "StaticCatalog.h"
+#endif
+
+// The product definitions are loaded from share/products.txt and compiled
+// into flat tables indexed by [product][SOType]. The compiled tables are
+// cached in products.cache in the user cache directory (see CacheDir.h),
+// which is mapped directly on later starts while the source is unchanged.
+// When built with SR3_STATIC_CATALOG the tables are constexpr arrays
+// generated at build time instead and the text file is not read.
+// Labour is not a product but has an ID one past the last product so that
+// it can appear in recipes.
 class ProductCatalog {
 	public:
 		const std::vector<std::string>& getNames() const;
@@ -51,16 +48,139 @@ class ProductCatalog {
 		float getLabourRequired(const std::string& prod, const SolarObject& obj) const;
 		float getMaxProduction(const std::string& prod, const SolarObject& obj) const;
 
-		std::map<std::string, float> getRequiredGoods(const std::string& prod, const SolarObject& obj) const;
+#ifdef SR3_STATIC_CATALOG
+		static constexpr unsigned int getNumProducts() { return StaticCatalog::NumProducts; }
+		static constexpr ProductId getLabourId() { return StaticCatalog::NumProducts; }
+		static constexpr ProductId getStapleId() { return StaticCatalog::Staple; }
+#else
+		unsigned int getNumProducts() const { return mNames.size(); }
+		ProductId getLabourId() const { return mNames.size(); }
+		ProductId getStapleId() const { return mStaple; }
+#endif
+		ProductId getId(const std::string& prod) const;
+		const std::string& getName(ProductId id) const { return mIdNames[id]; }
+
+		// goods other than the staple with a non-zero consumption
+		const std::vector<ProductId>& getLuxuries(SOType t) const
+		{
+			return mLuxuries[(unsigned int)t];
+		}
+
+		float getConsumption(ProductId prod, SOType t) const
+		{
+			return consumption()[index(prod, t)];
+		}
+
+		float getMaxProduction(ProductId prod, SOType t, float area) const
+		{
+			auto i = index(prod, t);
+			if(areaFactor()[i] < 0.0f)
+				return productionCap()[i];
+			return std::min(productionCap()[i], areaFactor()[i] * area);
+		}
+
+		Recipe getRecipe(ProductId prod, SOType t) const
+		{
+			auto i = index(prod, t);
+			return Recipe { recipeInputs() + recipeStart()[i], recipeStart()[i + 1] - recipeStart()[i] };
+		}
+
+		float getLabourRequired(ProductId prod, SOType t) const;
 
 	private:
 		ProductCatalog();
+		~ProductCatalog();
+		ProductCatalog(const ProductCatalog&) = delete;
+		ProductCatalog& operator=(const ProductCatalog&) & = delete;
+		void initNames(const std::vector<std::string>& names, ProductId staple);
+		static unsigned int index(ProductId prod, SOType t) { return prod * NumSOTypes + (unsigned int)t; }
 
 		std::vector<std::string> mNames;
-		std::map<std::string, Product> mProducts;
+		std::vector<std::string> mIdNames;
+		std::map<std::string, ProductId> mIds;
+		std::vector<ProductId> mLuxuries[NumSOTypes];
+
+#ifdef SR3_STATIC_CATALOG
+		static constexpr const float* consumption() { return StaticCatalog::Consumption; }
+		static constexpr const float* productionCap() { return StaticCatalog::ProductionCap; }
+		static constexpr const float* areaFactor() { return StaticCatalog::AreaFactor; }
+		static constexpr const unsigned int* recipeStart() { return StaticCatalog::RecipeStart; }
+		static constexpr const RecipeInput* recipeInputs() { return StaticCatalog::RecipeInputs; }
+#else
+		bool mapCache(const std::string& path, const std::string& source);
+		void writeCache(const std::string& path) const;
+		void compile(const CatalogDefinition& def, const std::string& source);
+		bool attach(const char* data, size_t size);
+		const float* consumption() const { return mConsumption; }
+		const float* productionCap() const { return mProductionCap; }
+		const float* areaFactor() const { return mAreaFactor; }
+		const unsigned int* recipeStart() const { return mRecipeStart; }
+		const RecipeInput* recipeInputs() const { return mRecipeInputs; }
+
+		ProductId mStaple = 0;
+
+		// compiled tables, either in mCompiled or in the mapped cache
+		std::vector<char> mCompiled;
+		void* mCacheMap = nullptr;
+		size_t mCacheSize = 0;
+		const float* mConsumption = nullptr;
+		const float* mProductionCap = nullptr;
+		const float* mAreaFactor = nullptr;
+		const unsigned int* mRecipeStart = nullptr;
+		const RecipeInput* mRecipeInputs = nullptr;
+#endif
+};
+
+// A value for each product ID, including Labour. With the static catalog
+// this is a fixed-size array, otherwise it is sized when constructed.
+#ifdef SR3_STATIC_CATALOG
+template<typename T>
+class PerProduct : public std::array<T, StaticCatalog::NumProducts + 1> {
+	public:
+		PerProduct() : std::array<T, StaticCatalog::NumProducts + 1>() { }
+};
+#else
+template<typename T>
+class PerProduct : public std::vector<T> {
+	public:
+		PerProduct() : std::vector<T>(ProductCatalog::getInstance()->getNumProducts() + 1) { }
+};
+#endif
 
+// Calls f on each input of the recipe. With the static catalog the loop
+// is unrolled up to the longest recipe in the catalog.
+#ifdef SR3_STATIC_CATALOG
+template<unsigned int N>
+struct RecipeLoop {
+	template<typename F>
+	static void apply(const RecipeInput* in, unsigned int size, F& f)
+	{
+		if(size == 0)
+			return;
+		f(*in);
+		RecipeLoop<N - 1>::apply(in + 1, size - 1, f);
+	}
 };
 
+template<>
+struct RecipeLoop<0> {
+	template<typename F>
+	static void apply(const RecipeInput*, unsigned int, F&) { }
+};
 
+template<typename F>
+inline void forEachInput(const Recipe& r, F f)
+{
+	RecipeLoop<StaticCatalog::MaxRecipeSize>::apply(r.First, r.Size, f);
+}
+#else
+template<typename F>
+inline void forEachInput(const Recipe& r, F f)
+{
+	for(const auto& in : r)
+		f(in);
+}
 #endif
 
+
+#endif
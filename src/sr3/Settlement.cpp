@@ -1,102 +1,122 @@
 #include <cassert>
-#include <cfloat>
 #include <climits>
 
 #include "Settlement.h"
 #include "SolarObject.h"
 #include "Product.h"
 #include "Econ.h"
+#include "StateBuffer.h"
 
-#include "common/Random.h"
+// the class constants may be bound to references, so they need a definition
+const unsigned int InlineLayout::InlineSize;
+const unsigned int Market::NoOrder;
+const unsigned int SettlementArena::None;
 
-Storage::Storage(unsigned int maxCapacity)
-	: mMaxCapacity(maxCapacity),
-	mCapacityLeft(maxCapacity)
+void BoundedCapacity::save(StateWriter& w) const
 {
+	w.write(mMaxCapacity);
+	w.write(mCapacityLeft);
 }
 
-unsigned int Storage::items(const std::string& product) const
+void BoundedCapacity::load(StateReader& r)
 {
-	auto it = mStorage.find(product);
-	if(it == mStorage.end())
-		return 0;
-	return it->second;
+	r.read(mMaxCapacity);
+	r.read(mCapacityLeft);
 }
 
-unsigned int Storage::add(const std::string& product, unsigned int num)
+void InlineLayout::add(ProductId product, unsigned int num)
 {
-	if(mMaxCapacity && mCapacityLeft < num) {
-		num = mCapacityLeft;
+	auto i = find(product);
+	if(i < mSize) {
+		at(i).Count += num;
+		return;
 	}
-	mStorage[product] += num;
-	if(mMaxCapacity)
-		mCapacityLeft -= num;
-	return num;
+	if(mSize < InlineSize)
+		mInline[mSize] = Item{product, num};
+	else
+		mOverflow.push_back(Item{product, num});
+	mSize++;
 }
 
-unsigned int Storage::remove(const std::string& product, unsigned int num)
+void InlineLayout::remove(ProductId product, unsigned int num)
 {
-	auto it = mStorage.find(product);
-	if(it == mStorage.end())
-		return 0;
-	if(it->second >= num) {
-		it->second -= num;
-		if(mMaxCapacity)
-			mCapacityLeft += num;
-		return num;
-	} else {
-		auto val = it->second;
-		it->second = 0;
-		if(mMaxCapacity)
-			mCapacityLeft += val;
-		return val;
-	}
+	auto i = find(product);
+	assert(i < mSize && at(i).Count >= num);
+	at(i).Count -= num;
+	if(at(i).Count)
+		return;
+
+	// keep the order so that iterating stays deterministic
+	for(; i + 1 < mSize; i++)
+		at(i) = at(i + 1);
+	if(mSize > InlineSize)
+		mOverflow.pop_back();
+	mSize--;
 }
 
-unsigned int Storage::capacityLeft() const
+void InlineLayout::save(StateWriter& w) const
 {
-	if(mMaxCapacity)
-		return mCapacityLeft;
-	else
-		return UINT_MAX;
+	w.write(mSize);
+	for(unsigned int i = 0; i < mSize; i++)
+		w.write(at(i));
 }
 
-void Storage::clearAll()
+void InlineLayout::load(StateReader& r)
 {
-	for(auto it : mStorage) {
-		remove(it.first, it.second);
+	unsigned int size;
+	r.read(size);
+	clear();
+	for(unsigned int i = 0; i < size; i++) {
+		Item item;
+		r.read(item);
+		add(item.Product, item.Count);
 	}
-	assert(mCapacityLeft == mMaxCapacity);
 }
 
-void Storage::clearProduct(const std::string& product)
+template<typename S>
+BasicTrader<S>::BasicTrader(Money money, unsigned int storage)
+	: mMoney(money),
+	mStorage(storage)
 {
-	auto it = mStorage.find(product);
-	auto num = it == mStorage.end() ? 0 : it->second;
-	if(num)
-		remove(product, num);
 }
 
-Trader::Trader(float money, unsigned int storage)
+template<typename S>
+BasicTrader<S>::BasicTrader(Money money, const S& storage)
 	: mMoney(money),
 	mStorage(storage)
 {
 }
 
-unsigned int Trader::buy(const std::string& product, unsigned int number, float price, Trader& buyer)
+template<typename S>
+BasicTrader<S>::BasicTrader(InfiniteFunds, unsigned int storage)
+	: mInfinite(true),
+	mStorage(storage)
+{
+}
+
+template<typename S>
+BasicTrader<S>::BasicTrader(const BasicTrader& t, const S& storage)
+	: mMoney(t.mMoney),
+	mInfinite(t.mInfinite),
+	mStorage(storage)
+{
+}
+
+template<typename S>
+template<typename T>
+unsigned int BasicTrader<S>::buy(ProductId product, unsigned int number, Money price, T& buyer)
 {
-	assert(price >= 0.0f);
+	assert(price >= Money());
 
 	unsigned int tobuy = number;
-	long double tobuy_float = std::min<long double>(buyer.getMoney() / price, (long double)number);
-	tobuy = static_cast<unsigned int>(tobuy_float);
+	if(price > Money())
+		tobuy = std::min<int64_t>(buyer.getMoney() / price, number);
 	tobuy = std::min<unsigned int>(tobuy, mStorage.items(product));
 	tobuy = std::min<unsigned int>(tobuy, buyer.storageLeft());
 	if(tobuy) {
-		float total_cost = tobuy * price;
+		auto total_cost = price * tobuy;
 		buyer.removeMoney(total_cost);
-		assert(buyer.getMoney() >= 0.0f);
-		if(mMoney >= 0.0f)
+		if(!mInfinite)
 			mMoney += total_cost;
 		auto nums = buyer.addToStorage(product, tobuy);
 		assert(nums == tobuy);
@@ -108,101 +128,143 @@ unsigned int Trader::buy(const std::string& product, unsigned int number, float
 	}
 }
 
-unsigned int Trader::sell(const std::string& product, unsigned int number, float price, Trader& seller)
+template<typename S>
+Money BasicTrader<S>::getMoney() const
 {
-	return seller.buy(product, number, price, *this);
+	return mInfinite ? Money::max() : mMoney;
 }
 
-float Trader::getMoney() const
+template<typename S>
+void BasicTrader<S>::addMoney(Money val)
 {
-	if(mMoney < 0.0f)
-		return FLT_MAX;
-	else
-		return mMoney;
+	assert(val > Money());
+	if(!mInfinite)
+		mMoney += val;
 }
 
-void Trader::addMoney(float val)
+template<typename S>
+void BasicTrader<S>::removeMoney(Money val)
 {
-	assert(val > 0.0f);
-	assert(mMoney >= 0.0f);
-	mMoney += val;
+	if(mInfinite)
+		return;
+	assert(mMoney >= val);
+	mMoney -= val;
 }
 
-float Trader::removeMoney(float val)
+template<typename S>
+unsigned int BasicTrader<S>::addToStorage(const std::string& product, unsigned int number)
 {
-	if(mMoney < 0.0f)
-		return FLT_MAX;
-	assert(mMoney >= val);
-	mMoney -= val;
-	return mMoney;
+	return addToStorage(ProductCatalog::getInstance()->getId(product), number);
+}
+
+template<typename S>
+unsigned int BasicTrader<S>::removeFromStorage(const std::string& product, unsigned int number)
+{
+	return removeFromStorage(ProductCatalog::getInstance()->getId(product), number);
 }
 
-unsigned int Trader::addToStorage(const std::string& product, unsigned int number)
+template<typename S>
+unsigned int BasicTrader<S>::items(const std::string& product) const
 {
-	return mStorage.add(product, number);
+	return items(ProductCatalog::getInstance()->getId(product));
 }
 
-unsigned int Trader::removeFromStorage(const std::string& product, unsigned int number)
+template<typename S>
+void BasicTrader<S>::clearProduct(const std::string& product)
 {
-	return mStorage.remove(product, number);
+	clearProduct(ProductCatalog::getInstance()->getId(product));
 }
 
-unsigned int Trader::storageLeft() const
+template<typename S>
+void BasicTrader<S>::save(StateWriter& w) const
 {
-	return mStorage.capacityLeft();
+	w.write(mMoney);
+	w.write(mInfinite);
+	mStorage.save(w);
 }
 
-unsigned int Trader::items(const std::string& product) const
+template<typename S>
+void BasicTrader<S>::load(StateReader& r)
 {
-	return mStorage.items(product);
+	r.read(mMoney);
+	r.read(mInfinite);
+	mStorage.load(r);
 }
 
-void Trader::clearAll()
+template class BasicTrader<MarketStorage>;
+template class BasicTrader<HoldStorage>;
+template class BasicTrader<CargoStorage>;
+template unsigned int MarketTrader::buy(ProductId, unsigned int, Money, Trader&);
+template unsigned int MarketTrader::buy(ProductId, unsigned int, Money, ShipTrader&);
+template unsigned int Trader::buy(ProductId, unsigned int, Money, MarketTrader&);
+template unsigned int ShipTrader::buy(ProductId, unsigned int, Money, MarketTrader&);
+
+Market::Market(MarketTable* table, Money money)
+	: mTable(table),
+	mColumn(table->addColumn()),
+	mTrader(money, MarketStorage(0, ColumnLayout(table, mColumn)))
 {
-	mStorage.clearAll();
 }
 
-void Trader::clearProduct(const std::string& product)
+Market::Market(const Market& m, MarketTable* table)
+	: mTable(table),
+	mColumn(table->addColumn()),
+	mTrader(m.mTrader, MarketStorage(0, ColumnLayout(table, mColumn))),
+	mCallAuction(m.mCallAuction)
 {
-	mStorage.clearProduct(product);
+	mTable->copyColumn(mColumn, *m.mTable, m.mColumn);
 }
 
-Market::Market(float money)
-	: mTrader(money, 0)
+Market::~Market()
 {
+	mTable->freeColumn(mColumn);
+}
+
+void Market::copyState(const Market& m)
+{
+	mTable->copyColumn(mColumn, *m.mTable, m.mColumn);
+	mTrader.copyMoney(m.mTrader);
+	mCallAuction = m.mCallAuction;
+	mOrders.clear();
+	mCleared = false;
 }
 
 float Market::getPrice(const std::string& product) const
 {
-	auto it = mPrices.find(product);
-	if(it == mPrices.end())
-		return 1.0f;
-	else
-		return it->second;
+	return getPrice(ProductCatalog::getInstance()->getId(product));
 }
 
 unsigned int Market::items(const std::string& product) const
 {
-	return mTrader.items(product);
+	return items(ProductCatalog::getInstance()->getId(product));
 }
 
-float Market::getMoney() const
+Money Market::getMoney() const
 {
 	return mTrader.getMoney();
 }
 
-void Market::addMoney(float val)
+void Market::addMoney(Money val)
 {
 	mTrader.addMoney(val);
 }
 
-unsigned int Market::buy(const std::string& product, unsigned int number, Trader& buyer, Econ::Entity ent, const SolarObject* solarObject)
+void Market::removeMoney(Money val)
+{
+	mTrader.removeMoney(val);
+}
+
+template<typename T>
+unsigned int Market::buy(ProductId product, unsigned int number, T& buyer, Econ::Entity ent, const SolarObject* solarObject)
 {
-	auto p = getPrice(product);
+	auto p = getTradePrice(product);
 	auto i = mTrader.buy(product, number, p, buyer);
-	mSurplus[product] -= i;
+	mTable->surplus(product, mColumn) -= i;
+	mTable->traded(product, mColumn) = 1;
+	if(ent == Econ::Entity::Trader)
+		mTable->markForeignTrade(mColumn);
 	if(i) {
-		if(product == "Labour") {
+		if(product == ProductCatalog::getInstance()->getLabourId()) {
 			// pay labour credit
 			mTrader.removeMoney(p * i);
 		}
@@ -212,19 +274,32 @@ unsigned int Market::buy(const std::string& product, unsigned int number, Trader
 	return i;
 }
 
-unsigned int Market::sell(const std::string& product, unsigned int number, Trader& seller, Econ::Entity ent, const SolarObject* solarObject)
+template<typename T>
+unsigned int Market::buy(const std::string& product, unsigned int number, T& buyer, Econ::Entity ent, const SolarObject* solarObject)
 {
-	auto p = getPrice(product);
-	if(number && product == "Labour") {
+	return buy(ProductCatalog::getInstance()->getId(product), number, buyer, ent, solarObject);
+}
+
+template<typename T>
+unsigned int Market::sell(ProductId product, unsigned int number, T& seller, Econ::Entity ent, const SolarObject* solarObject)
+{
+	auto p = getTradePrice(product);
+	bool labour = product == ProductCatalog::getInstance()->getLabourId();
+	if(number && labour) {
 		// loan money for labour since it will always even itself out
 		mTrader.addMoney(p * number);
 	}
 
 	auto i = mTrader.sell(product, number, p, seller);
 
-	mSurplus[product] += i;
+	mTable->surplus(product, mColumn) += i;
+	mTable->traded(product, mColumn) = 1;
+	if(i)
+		mTable->listed(product, mColumn) = 1;
+	if(ent == Econ::Entity::Trader)
+		mTable->markForeignTrade(mColumn);
 
-	if(number && product == "Labour" && i != number) {
+	if(number && labour && i != number) {
 		mTrader.removeMoney(p * (number - i));
 	}
 
@@ -232,44 +307,125 @@ unsigned int Market::sell(const std::string& product, unsigned int number, Trade
 	return i;
 }
 
-unsigned int Market::fixLabour()
+template<typename T>
+unsigned int Market::sell(const std::string& product, unsigned int number, T& seller, Econ::Entity ent, const SolarObject* solarObject)
 {
-	// can simply remove items and consider the labour credit paid
-	auto unemployment = items("Labour");
-	mTrader.clearProduct("Labour");
-	return unemployment;
+	return sell(ProductCatalog::getInstance()->getId(product), number, seller, ent, solarObject);
 }
 
-void Market::updatePrices()
+template unsigned int Market::buy(ProductId, unsigned int, Trader&, Econ::Entity, const SolarObject*);
+template unsigned int Market::buy(ProductId, unsigned int, ShipTrader&, Econ::Entity, const SolarObject*);
+template unsigned int Market::buy(const std::string&, unsigned int, Trader&, Econ::Entity, const SolarObject*);
+template unsigned int Market::buy(const std::string&, unsigned int, ShipTrader&, Econ::Entity, const SolarObject*);
+template unsigned int Market::sell(ProductId, unsigned int, Trader&, Econ::Entity, const SolarObject*);
+template unsigned int Market::sell(ProductId, unsigned int, ShipTrader&, Econ::Entity, const SolarObject*);
+template unsigned int Market::sell(const std::string&, unsigned int, Trader&, Econ::Entity, const SolarObject*);
+template unsigned int Market::sell(const std::string&, unsigned int, ShipTrader&, Econ::Entity, const SolarObject*);
+
+void Market::beginOrders()
 {
-	assert(mTrader.items("Labour") == 0);
-	for(const auto& it : mTrader.getStorage()) {
-		auto prodname = it.first;
-		auto trans_it = mSurplus.find(prodname);
-		auto hadTrans = trans_it != mSurplus.end();
-		if(!hadTrans)
-			continue;
-		auto surp = trans_it->second;
+	if(mCleared) {
+		mOrders.clear();
+		mCleared = false;
+	}
+}
 
-		if(mPrices.find(prodname) == mPrices.end()) {
-			mPrices[prodname] = 1.0f;
-		}
+unsigned int Market::post(const Order& o)
+{
+	beginOrders();
+	mOrders.push_back(o);
+	return mOrders.size() - 1;
+}
 
-		if(surp > 0) {
-			mPrices[prodname] = mPrices[prodname] / (1.10f + Common::Random::uniform() * 0.1f);
-			if(mPrices[prodname] < 0.01f)
-				mPrices[prodname] = 0.01f;
-		} else {
-			if(mTrader.items(prodname) == 0) {
-				mPrices[prodname] = mPrices[prodname] * (1.10f + Common::Random::uniform() * 0.1f);
-			}
+unsigned int Market::postBuy(ProductId product, unsigned int number,
+		Trader& buyer, Econ::Entity ent, const SolarObject* solarObject)
+{
+	auto price = getTradePrice(product);
+	if(price > Money()) {
+		// the money for the earlier buys of the same buyer is set aside
+		beginOrders();
+		auto money = buyer.getMoney();
+		for(const auto& o : mOrders) {
+			if(!o.Sell && o.Party == &buyer)
+				money -= getTradePrice(o.Product) * o.Number;
 		}
+		number = money > Money() ? std::min<int64_t>(number, money / price) : 0;
 	}
-	mSurplus.clear();
+	return post(Order{product, number, false, &buyer, ent, solarObject, 0});
 }
 
+unsigned int Market::postSell(ProductId product, unsigned int number,
+		Trader& seller, Econ::Entity ent, const SolarObject* solarObject)
+{
+	return post(Order{product, number, true, &seller, ent, solarObject, 0});
+}
+
+void Market::clearOrders()
+{
+	// total demand per product, only used within this function
+	static thread_local PerProduct<uint64_t> demand;
+	auto labour = ProductCatalog::getInstance()->getLabourId();
+
+	// sells share the money of the market at the prices charged, in
+	// units; labour is paid for with a loan, so it is always taken in full
+	double value = 0.0;
+	for(const auto& o : mOrders) {
+		if(o.Sell && o.Product != labour)
+			value += double(getTradePrice(o.Product).getUnits()) * o.Number;
+	}
+	double money = getMoney().getUnits();
+	double share = value > money ? money / value : 1.0;
+	for(auto& o : mOrders) {
+		if(!o.Sell)
+			continue;
+		unsigned int num = o.Product == labour || share == 1.0 ? o.Number : o.Number * share;
+		o.Filled = sell(o.Product, num, *o.Party, o.Entity, o.Object);
+	}
+
+	// buys share the stock, which the sells above have added to
+	for(const auto& o : mOrders) {
+		if(!o.Sell)
+			demand[o.Product] += o.Number;
+	}
+	for(auto& o : mOrders) {
+		if(o.Sell)
+			continue;
+		uint64_t d = demand[o.Product];
+		uint64_t stock = items(o.Product);
+		o.Filled = d <= stock ? o.Number : o.Number * stock / d;
+	}
+	for(auto& o : mOrders) {
+		if(o.Sell)
+			continue;
+		o.Filled = buy(o.Product, o.Filled, *o.Party, o.Entity, o.Object);
+		demand[o.Product] = 0;
+	}
+	mCleared = true;
+}
 
-Population::Population(unsigned int num, float money, const SolarObject* obj)
+unsigned int Market::fixLabour()
+{
+	// can simply remove items and consider the labour credit paid
+	auto labour = ProductCatalog::getInstance()->getLabourId();
+	auto unemployment = items(labour);
+	mTrader.clearProduct(labour);
+	return unemployment;
+}
+
+void Market::save(StateWriter& w) const
+{
+	mTrader.save(w);
+	mTable->saveColumn(w, mColumn);
+}
+
+void Market::load(StateReader& r)
+{
+	mTrader.load(r);
+	mTable->loadColumn(r, mColumn);
+}
+
+
+Population::Population(unsigned int num, Money money, const SolarObject* obj)
 	: mNum(num),
 	mTrader(money * num, 0),
 	mSolarObject(obj)
@@ -277,10 +433,10 @@ Population::Population(unsigned int num, float money, const SolarObject* obj)
 	assert(mNum <= mSolarObject->getMaxPopulation()); // cap at 1 million/earth
 }
 
-bool Population::update(Market& m)
+bool Population::update(Market& m, unsigned int ticks)
 {
-	auto famine = consume(m);
-	work(m);
+	auto famine = consume(m, ticks);
+	work(m, ticks);
 	return famine;
 }
 
@@ -288,40 +444,28 @@ unsigned int Population::calculateConsumption(float coeff) const
 {
 	float totalConsumption = mNum * coeff;
 	float rem = fmodf(totalConsumption, 1.0f);
-	unsigned int remConsumption = rem != 0.0f ? (Common::Random::uniform() < rem ? 1 : 0) : 0;
+	unsigned int remConsumption = rem != 0.0f ? (Econ::uniform() < rem ? 1 : 0) : 0;
 	return (unsigned int) totalConsumption + remConsumption;
 }
 
-bool Population::consume(Market& m)
+bool Population::consume(Market& m, unsigned int ticks)
 {
+	auto catalog = ProductCatalog::getInstance();
+	auto staple = catalog->getStapleId();
 	bool famine = false;
-	unsigned int fruitConsumption = calculateConsumption(ProductCatalog::getInstance()->getConsumption("Fruit", *mSolarObject));
-	if(fruitConsumption) {
-		unsigned int bought = m.buy("Fruit", fruitConsumption, mTrader, Econ::Entity::Population, mSolarObject);
-
-		if(bought < fruitConsumption) {
-			mNum = mNum / (1.00f + Common::Random::uniform() * 0.1f);
-			famine = true;
-#if 1
-			const char* reason = "unknown";
-			if(mTrader.getMoney() < m.getPrice("Fruit"))
-				reason = "no money";
-			else if(m.items("Fruit") == 0)
-				reason = "no fruit";
-			printf("Famine! Need %5u fruit, could only buy %5u. Reason: %s\n",
-					fruitConsumption, bought, reason);
-#endif
-		} else {
-			mNum = mNum * (1.00f + Common::Random::uniform() * 0.1f);
-		}
-		mNum = std::min<unsigned int>(mNum, mSolarObject->getMaxPopulation());
+	auto type = mSolarObject->getType();
+	unsigned int stapleConsumption = calculateConsumption(catalog->getConsumption(staple, type) * ticks);
+	if(stapleConsumption) {
+		unsigned int bought = m.buy(staple, stapleConsumption, mTrader, Econ::Entity::Population, mSolarObject);
+		famine = eat(m, stapleConsumption, bought, ticks);
 	}
 
 	if(!famine) {
-		unsigned int luxuryConsumption =
-			calculateConsumption(ProductCatalog::getInstance()->getConsumption("Luxury goods", *mSolarObject));
-		if(luxuryConsumption) {
-			m.buy("Luxury goods", luxuryConsumption, mTrader, Econ::Entity::Population, mSolarObject);
+		for(auto id : catalog->getLuxuries(type)) {
+			unsigned int consumption = calculateConsumption(catalog->getConsumption(id, type) * ticks);
+			if(consumption) {
+				m.buy(id, consumption, mTrader, Econ::Entity::Population, mSolarObject);
+			}
 		}
 	}
 
@@ -329,25 +473,95 @@ bool Population::consume(Market& m)
 	return famine;
 }
 
-void Population::work(Market& m)
+bool Population::eat(const Market& m, unsigned int needed, unsigned int bought, unsigned int ticks)
 {
-	unsigned int labour = mNum * Constants::LabourProducedByCitizen;
-	mTrader.addToStorage("Labour", labour);
-	unsigned int num = m.sell("Labour", labour, mTrader, Econ::Entity::Population, mSolarObject);
+	// the change of each tick with a draw of its own, as in single updates
+	bool famine = false;
+	if(bought < needed) {
+		for(unsigned int i = 0; i < ticks; i++)
+			mNum = mNum / (1.00f + Econ::uniform() * 0.1f);
+		famine = true;
+#if 1
+		auto catalog = ProductCatalog::getInstance();
+		auto staple = catalog->getStapleId();
+		const char* reason = "unknown";
+		if(mTrader.getMoney() < m.getTradePrice(staple))
+			reason = "no money";
+		else if(m.items(staple) == 0)
+			reason = "no stock";
+		printf("Famine! Need %5u %s, could only buy %5u. Reason: %s\n",
+				needed, catalog->getName(staple).c_str(), bought, reason);
+#endif
+	} else {
+		for(unsigned int i = 0; i < ticks; i++)
+			mNum = std::min<unsigned int>(mNum * (1.00f + Econ::uniform() * 0.1f),
+					mSolarObject->getMaxPopulation());
+	}
+	mNum = std::min<unsigned int>(mNum, mSolarObject->getMaxPopulation());
+	return famine;
+}
+
+void Population::postOrders(Market& m, unsigned int ticks)
+{
+	auto catalog = ProductCatalog::getInstance();
+	auto staple = catalog->getStapleId();
+	auto type = mSolarObject->getType();
+	mStapleNeeded = calculateConsumption(catalog->getConsumption(staple, type) * ticks);
+	if(mStapleNeeded)
+		mStapleOrder = m.postBuy(staple, mStapleNeeded, mTrader, Econ::Entity::Population, mSolarObject);
+
+	unsigned int labour = mNum * Constants::LabourProducedByCitizen * ticks;
+	auto labourId = catalog->getLabourId();
+	mTrader.addToStorage(labourId, labour);
+	m.postSell(labourId, labour, mTrader, Econ::Entity::Population, mSolarObject);
+}
+
+bool Population::settleOrders(const Market& m, unsigned int ticks)
+{
+	bool famine = false;
+	if(mStapleNeeded)
+		famine = eat(m, mStapleNeeded, m.getFilled(mStapleOrder), ticks);
+	assert(mTrader.items(ProductCatalog::getInstance()->getLabourId()) == 0);
+	mTrader.clearAll();
+	return famine;
+}
+
+void Population::postLuxuries(Market& m, unsigned int ticks)
+{
+	auto catalog = ProductCatalog::getInstance();
+	auto type = mSolarObject->getType();
+	for(auto id : catalog->getLuxuries(type)) {
+		unsigned int consumption = calculateConsumption(catalog->getConsumption(id, type) * ticks);
+		if(consumption)
+			m.postBuy(id, consumption, mTrader, Econ::Entity::Population, mSolarObject);
+	}
+}
+
+void Population::settleLuxuries()
+{
+	mTrader.clearAll();
+}
+
+void Population::work(Market& m, unsigned int ticks)
+{
+	unsigned int labour = mNum * Constants::LabourProducedByCitizen * ticks;
+	auto labourId = ProductCatalog::getInstance()->getLabourId();
+	mTrader.addToStorage(labourId, labour);
+	unsigned int num = m.sell(labourId, labour, mTrader, Econ::Entity::Population, mSolarObject);
 	assert(num == labour);
 }
 
-float Population::getMoney() const
+Money Population::getMoney() const
 {
 	return mTrader.getMoney();
 }
 
-void Population::addMoney(float val)
+void Population::addMoney(Money val)
 {
 	mTrader.addMoney(val);
 }
 
-void Population::removeMoney(float m)
+void Population::removeMoney(Money m)
 {
 	mTrader.removeMoney(m);
 }
@@ -369,218 +583,612 @@ void Population::addPop(unsigned int num)
 	mNum += num;
 }
 
-Producer::Producer(const std::string& prod, unsigned int money)
-	: mProduct(prod),
+void Population::save(StateWriter& w) const
+{
+	w.write(mNum);
+	mTrader.save(w);
+}
+
+void Population::load(StateReader& r)
+{
+	r.read(mNum);
+	mTrader.load(r);
+}
+
+Producer::Producer(ProductId product, Money money)
+	: mProductId(product),
 	mTrader(money, 0)
 {
 }
 
-void Producer::enhance(float money)
+Producer::Producer(StateReader& r)
+	: mTrader(Money(), 0)
+{
+	std::string product;
+	r.read(product);
+	mProductId = ProductCatalog::getInstance()->getId(product);
+	mTrader.load(r);
+	r.read(mLevel);
+}
+
+void Producer::enhance(Money money)
 {
 	mTrader.addMoney(money);
 	mLevel++;
 }
 
-float Producer::deenhance()
+Money Producer::deenhance()
 {
 	auto money = mTrader.getMoney();
-	if(money > 1000.0f && mLevel > 1) {
-		mTrader.removeMoney(1000.0f);
+	if(money > Money::credits(1000) && mLevel > 1) {
+		mTrader.removeMoney(Money::credits(1000));
 		mLevel--;
-		return 1000.0f;
+		return Money::credits(1000);
 	} else {
-		return 0.0f;
+		return Money();
 	}
 }
 
-void Producer::addMoney(float val)
+void Producer::addMoney(Money val)
 {
 	mTrader.addMoney(val);
 }
 
-void Producer::removeMoney(float val)
+void Producer::removeMoney(Money val)
 {
 	mTrader.removeMoney(val);
 }
 
-float Producer::getMoney() const
+Money Producer::getMoney() const
 {
 	return mTrader.getMoney();
 }
 
-float Producer::getProductionPrice(const std::string& product, const Market& m, const SolarObject& obj)
+void Producer::save(StateWriter& w) const
+{
+	w.write(getProduct());
+	mTrader.save(w);
+	w.write(mLevel);
+}
+
+float Producer::getProductionPrice(ProductId product, const Market& m, const SolarObject& obj)
 {
+	auto catalog = ProductCatalog::getInstance();
 	float price = 0.0f;
-	for(const auto& it : ProductCatalog::getInstance()->getRequiredGoods(product, obj)) {
-		price += m.getPrice(it.first) * it.second;
+	for(const auto& in : catalog->getRecipe(product, obj.getType())) {
+		price += m.getPrice(in.Good) * in.Quantity;
 	}
 	return price;
 }
 
-unsigned int Producer::produce(Market& m, const Settlement& settlement)
+bool Producer::plan(const Market& m, const Settlement& settlement, unsigned int ticks,
+		unsigned int& wantProduce) const
 {
-	// Calculate price of input good per produced unit for each input good.
-	// The input good with the highest price is the bottleneck.
-	// The sum is the required amount needed to produce one unit.
-	// Calculate how many units we can afford with our money and buy input goods accordingly.
-	std::map<std::string, float> inputPricePerProducedUnit;
-	float totalMoneyNeededPerProducedUnit = 0.0f;
-	auto obj = settlement.getSolarObject();
-	auto reqGoods = ProductCatalog::getInstance()->getRequiredGoods(mProduct, *obj);
-	for(const auto& it : reqGoods) {
-		auto price = m.getPrice(it.first) * it.second;
-		inputPricePerProducedUnit[it.first] = price;
-		totalMoneyNeededPerProducedUnit += price;
-	}
+	// The sum of the input prices per produced unit is the price of one unit.
+	// Calculate how many units we can afford with our money.
+	assert(m.getPriceEpoch() == settlement.getMarket()->getPriceEpoch());
+	float totalMoneyNeededPerProducedUnit = settlement.getProductionCost(mProductId);
 
-	if(m.getPrice(mProduct) < totalMoneyNeededPerProducedUnit) {
+	if(m.getPrice(mProductId) < totalMoneyNeededPerProducedUnit) {
 		// not enough revenue to pay the expenses
-		return 0;
+		return false;
 	}
 
-	unsigned int maxCanAffordToProduce = mTrader.getMoney() / totalMoneyNeededPerProducedUnit;
-	float canProduce = ProductCatalog::getInstance()->getMaxProduction(mProduct, *obj);
-	unsigned int wantProduce = std::min<unsigned int>(maxCanAffordToProduce, canProduce);
-
-	std::map<std::string, unsigned int> neededGoodQuantities;
-	for(const auto& it : reqGoods) {
-		neededGoodQuantities[it.first] = wantProduce * it.second;
-	}
+	// clamped to what the producer could make, so that it fits in the result
+	auto unitCost = Money::fromCredits(totalMoneyNeededPerProducedUnit);
+	double canProduce = settlement.getMaxProduction(mProductId) * ticks;
+	double canAfford = unitCost > Money() ? mTrader.getMoney() / unitCost : canProduce;
+	wantProduce = std::min(canAfford, canProduce);
+	return true;
+}
 
+void Producer::make(const Settlement& settlement, unsigned int ticks)
+{
+	float canProduce = settlement.getMaxProduction(mProductId) * ticks;
+	auto recipe = ProductCatalog::getInstance()->getRecipe(mProductId, settlement.getSolarObject()->getType());
 	assert(mLevel > 0);
-	for(const auto& it : neededGoodQuantities) {
-		m.buy(it.first, it.second, mTrader, Econ::Entity::Industry, obj);
-	}
-
-	for(const auto& it : reqGoods) {
-		canProduce = std::min(canProduce, mTrader.items(it.first) / it.second);
-	}
+	forEachInput(recipe, [&](const RecipeInput& in) {
+		canProduce = std::min(canProduce, mTrader.items(in.Good) / in.Quantity);
+	});
 
 	canProduce = canProduce * (1.0f + (mLevel - 1) * 0.01f);
 	float rem = fmodf(canProduce, 1.0f);
-	unsigned int remProd = rem != 0.0f ? (Common::Random::uniform() < rem ? 1 : 0) : 0;
+	unsigned int remProd = rem != 0.0f ? (Econ::uniform() < rem ? 1 : 0) : 0;
 	unsigned int prod = (unsigned int) canProduce + remProd;
 
 	if(prod) {
-		mTrader.addToStorage(mProduct, prod);
-		for(const auto& it : reqGoods) {
-			mTrader.removeFromStorage(it.first, it.second * prod);
-		}
+		mTrader.addToStorage(mProductId, prod);
+		forEachInput(recipe, [&](const RecipeInput& in) {
+			mTrader.removeFromStorage(in.Good, in.Quantity * prod);
+		});
 	}
+}
+
+unsigned int Producer::produce(Market& m, const Settlement& settlement, unsigned int ticks)
+{
+	unsigned int wantProduce;
+	if(!plan(m, settlement, ticks, wantProduce))
+		return 0;
+
+	auto obj = settlement.getSolarObject();
+	auto recipe = ProductCatalog::getInstance()->getRecipe(mProductId, obj->getType());
+	forEachInput(recipe, [&](const RecipeInput& in) {
+		unsigned int needed = wantProduce * in.Quantity;
+		m.buy(in.Good, needed, mTrader, Econ::Entity::Industry, obj);
+	});
+
+	make(settlement, ticks);
 
 	unsigned int num = 0;
-	if(mTrader.items(mProduct)) {
-		auto have = mTrader.items(mProduct);
-		num = m.sell(mProduct, have, mTrader, Econ::Entity::Industry, obj);
+	if(mTrader.items(mProductId)) {
+		auto have = mTrader.items(mProductId);
+		num = m.sell(mProductId, have, mTrader, Econ::Entity::Industry, obj);
 	}
 
 	// in case we could not produce everything (lack of input supply),
 	// sell the remaining input goods.
-	for(const auto& it : reqGoods) {
-		if(mTrader.items(it.first)) {
-			auto have = mTrader.items(it.first);
-			m.sell(it.first, have, mTrader, Econ::Entity::IndustryCancel, obj);
+	forEachInput(recipe, [&](const RecipeInput& in) {
+		if(mTrader.items(in.Good)) {
+			auto have = mTrader.items(in.Good);
+			m.sell(in.Good, have, mTrader, Econ::Entity::IndustryCancel, obj);
 		}
-	}
+	});
 
 	printf("On %s, sold %u of wanted %u of %s.\n", obj->getName().c_str(), num,
-			wantProduce, mProduct.c_str());
+			wantProduce, getProduct().c_str());
 	mTrader.clearAll();
 	return num;
 }
 
+void Producer::postInputs(Market& m, const Settlement& settlement, unsigned int ticks)
+{
+	mOutputOrder = Market::NoOrder;
+	mPlanned = plan(m, settlement, ticks, mWantProduce);
+	if(!mPlanned)
+		return;
 
-Settlement::Settlement(unsigned int marketlevel, const SolarObject* obj)
-	: mMarket(marketlevel * 1000000.0f),
-	mPopulation(pow(5, marketlevel) + 200, marketlevel * 1000, obj),
-	mSolarObject(obj)
+	auto obj = settlement.getSolarObject();
+	auto recipe = ProductCatalog::getInstance()->getRecipe(mProductId, obj->getType());
+	forEachInput(recipe, [&](const RecipeInput& in) {
+		unsigned int needed = mWantProduce * in.Quantity;
+		m.postBuy(in.Good, needed, mTrader, Econ::Entity::Industry, obj);
+	});
+}
+
+void Producer::postOutputs(Market& m, const Settlement& settlement, unsigned int ticks)
+{
+	if(!mPlanned)
+		return;
+
+	make(settlement, ticks);
+	auto obj = settlement.getSolarObject();
+	if(mTrader.items(mProductId))
+		mOutputOrder = m.postSell(mProductId, mTrader.items(mProductId), mTrader, Econ::Entity::Industry, obj);
+
+	auto recipe = ProductCatalog::getInstance()->getRecipe(mProductId, obj->getType());
+	forEachInput(recipe, [&](const RecipeInput& in) {
+		if(mTrader.items(in.Good))
+			m.postSell(in.Good, mTrader.items(in.Good), mTrader, Econ::Entity::IndustryCancel, obj);
+	});
+}
+
+unsigned int Producer::settleOrders(const Market& m, const Settlement& settlement)
+{
+	if(!mPlanned)
+		return 0;
+
+	auto num = mOutputOrder == Market::NoOrder ? 0 : m.getFilled(mOutputOrder);
+	mTrader.clearAll();
+	return num;
+}
+
+SettlementSite::SettlementSite(SolarObject* obj)
+	: Object(obj)
+{
+	auto catalog = ProductCatalog::getInstance();
+	for(ProductId id = 0; id < catalog->getNumProducts(); id++) {
+		MaxProduction[id] = catalog->getMaxProduction(id, obj->getType(), obj->getArea());
+		if(MaxProduction[id] > 0.0f)
+			Producible.push_back(id);
+	}
+}
+
+Settlement::Settlement(unsigned int marketlevel, const SettlementSite* site, MarketTable* markets)
+	: mMarket(markets, Money::credits(marketlevel * 1000000)),
+	mPopulation(pow(5, marketlevel) + 200, Money::credits(marketlevel * 1000), site->Object),
+	mSite(site)
 {
 	assert(marketlevel <= 8);
 }
 
+Settlement::Settlement(const Settlement& s, MarketTable* markets)
+	: mMarket(s.mMarket, markets),
+	mPopulation(s.mPopulation),
+	mProducers(s.mProducers),
+	mHappiness(s.mHappiness),
+	mSettled(s.mSettled),
+	mOwnSite(new SettlementSite(*s.mSite)),
+	mSite(mOwnSite)
+{
+}
+
 Settlement::~Settlement()
 {
-	for(auto it : mProducers)
-		delete it.second;
+	delete mOwnSite;
+}
+
+Settlement* Settlement::clone(MarketTable* markets) const
+{
+	return new Settlement(*this, markets);
+}
+
+void Settlement::copyState(const Settlement& s)
+{
+	assert(mOwnSite && mSite->Object == s.mSite->Object);
+	mMarket.copyState(s.mMarket);
+	mPopulation = s.mPopulation;
+	mProducers = s.mProducers;
+	mHappiness = s.mHappiness;
+	mSettled = s.mSettled;
+	mCostEpoch = 0;
 }
 
-bool Settlement::update()
+Settlement::Settlement(StateReader& r, const SettlementSite* site, MarketTable* markets)
+	: mMarket(markets, Money()),
+	mPopulation(0, Money(), site->Object),
+	mSite(site)
 {
-	mMarket.updatePrices();
+	mMarket.load(r);
+	mPopulation.load(r);
+	r.read(mHappiness);
+	r.read(mSettled);
+	unsigned int num;
+	r.read(num);
+	mProducers.reserve(num);
+	for(unsigned int i = 0; i < num; i++)
+		mProducers.emplace_back(r);
+}
+
+void Settlement::save(StateWriter& w) const
+{
+	mMarket.save(w);
+	mPopulation.save(w);
+	w.write(mHappiness);
+	w.write(mSettled);
+	unsigned int num = mProducers.size();
+	w.write(num);
+	for(const auto& p : mProducers)
+		p.save(w);
+}
+
+bool Settlement::update(unsigned int ticks)
+{
+	assert(ticks > 0);
 	bool foundNewSettlement = false;
-	if(mPopulation.getNum() > 20) {
-		if(mPopulation.getMoney() > 10000.0f && mMarket.getMoney() < 10000.0f) {
+	auto pop = getPopulation();
+	auto levels = getProducerLevels();
+	auto money = mMarket.getMoney();
+	auto stock = getMarketStock();
+	bool famine = false;
+	if(!isAbandoned()) {
+		if(mPopulation.getMoney() > Money::credits(10000) && mMarket.getMoney() < Money::credits(10000)) {
 			// transfer money from population to market for more liquidity
-			mPopulation.removeMoney(5000.0f);
-			mMarket.addMoney(5000.0f);
+			mPopulation.removeMoney(Money::credits(5000));
+			mMarket.addMoney(Money::credits(5000));
 		}
 
-		auto famine = mPopulation.update(mMarket);
-		for(auto it : mProducers) {
-			auto num = it.second->produce(mMarket, *this);
-			if(num == 0) {
-				auto money = it.second->deenhance();
-				if(money > 0.0f)
-					mPopulation.addMoney(money);
-				if(it.second->getMoney() < 10000.0f && mPopulation.getMoney() > 10000.0f) {
-					// transfer money from population to industry for more liquidity
-					mPopulation.removeMoney(5000.0f);
-					it.second->addMoney(5000.0f);
-				}
-			}
-		}
+		famine = mMarket.isCallAuction() ? tradeByAuction(ticks) : trade(ticks);
 
 		auto unemployment = mMarket.fixLabour();
-		auto totalLabour = mPopulation.getNum() * Constants::LabourProducedByCitizen;
+		auto totalLabour = mPopulation.getNum() * Constants::LabourProducedByCitizen * ticks;
 		auto unemploymentRate = unemployment / totalLabour;
 		auto happiness = famine ? 0.0f : (1.0f - unemploymentRate);
-		mHappiness = happiness * 0.2f + 0.8f * mHappiness;
-		if(mPopulation.getNum() > Constants::MinPopulationForColonisation &&
-				mPopulation.getMoney() > Constants::MinPopulationMoneyForColonisation) {
-			if(Common::Random::uniform() < (1.0f - mHappiness)) {
+		if(ticks == 1) {
+			mHappiness = happiness * 0.2f + 0.8f * mHappiness;
+		} else {
+			// the average of each tick, applied ticks times
+			auto keep = powf(0.8f, ticks);
+			mHappiness = happiness * (1.0f - keep) + keep * mHappiness;
+		}
+		if(canColonise()) {
+			// the chance that any of the ticks would have colonised
+			if(Econ::uniform() < (1.0f - powf(mHappiness, ticks))) {
 				foundNewSettlement = true;
 			}
 		}
-	} else {
-		// TODO: abandon settlement
 	}
-	createNewProducers();
+	// an abandoned settlement is erased by the system after the update
+	createNewProducers(ticks);
+	auto changed = [] (double before, double after) {
+		return std::fabs(after - before) > Constants::SettledMarketChange * before; };
+	mSettled = !famine && getPopulation() == pop && getProducerLevels() == levels &&
+		!changed(money.getUnits(), mMarket.getMoney().getUnits()) &&
+		!changed(stock, getMarketStock()) &&
+		mMarket.getVolatility() < Constants::VolatileMarket;
 
 	return foundNewSettlement;
 }
 
+unsigned int Settlement::getProducerLevels() const
+{
+	unsigned int levels = 0;
+	for(const auto& p : mProducers)
+		levels += p.getLevel();
+	return levels;
+}
+
+uint64_t Settlement::getMarketStock() const
+{
+	uint64_t stock = 0;
+	mMarket.getTrader().forEachItem([&] (ProductId, unsigned int num) { stock += num; });
+	return stock;
+}
+
+Money Settlement::takeAllMoney()
+{
+	auto money = mPopulation.getMoney();
+	if(money > Money())
+		mPopulation.removeMoney(money);
+	auto m = mMarket.getMoney();
+	if(m > Money()) {
+		mMarket.removeMoney(m);
+		money += m;
+	}
+	for(auto& p : mProducers) {
+		m = p.getMoney();
+		if(m > Money()) {
+			p.removeMoney(m);
+			money += m;
+		}
+	}
+	return money;
+}
+
+bool Settlement::canColonise() const
+{
+	return mPopulation.getNum() > Constants::MinPopulationForColonisation &&
+		mPopulation.getMoney() > Constants::MinPopulationMoneyForColonisation;
+}
+
+bool Settlement::trade(unsigned int ticks)
+{
+	auto famine = mPopulation.update(mMarket, ticks);
+	for(auto& p : mProducers)
+		checkProducer(p, p.produce(mMarket, *this, ticks), ticks);
+	return famine;
+}
+
+bool Settlement::tradeByAuction(unsigned int ticks)
+{
+	// labour and consumption, then the inputs of production
+	mPopulation.postOrders(mMarket, ticks);
+	for(auto& p : mProducers)
+		p.postInputs(mMarket, *this, ticks);
+	mMarket.clearOrders();
+	auto famine = mPopulation.settleOrders(mMarket, ticks);
+
+	// the goods produced and unused inputs, and the luxuries unless the
+	// staples ran short, as in consume()
+	if(!famine)
+		mPopulation.postLuxuries(mMarket, ticks);
+	for(auto& p : mProducers)
+		p.postOutputs(mMarket, *this, ticks);
+	mMarket.clearOrders();
+	mPopulation.settleLuxuries();
+	for(auto& p : mProducers)
+		checkProducer(p, p.settleOrders(mMarket, *this), ticks);
+	return famine;
+}
+
+void Settlement::checkProducer(Producer& p, unsigned int sold, unsigned int ticks)
+{
+	if(sold)
+		return;
+	// a level for each tick without sales
+	for(unsigned int i = 0; i < ticks; i++) {
+		auto money = p.deenhance();
+		if(money > Money())
+			mPopulation.addMoney(money);
+	}
+	if(p.getMoney() < Money::credits(10000) && mPopulation.getMoney() > Money::credits(10000)) {
+		// transfer money from population to industry for more liquidity
+		mPopulation.removeMoney(Money::credits(5000));
+		p.addMoney(Money::credits(5000));
+	}
+}
+
 unsigned int Settlement::getPopulation() const
 {
 	return mPopulation.getNum();
 }
 
-float Settlement::getPopulationMoney() const
+Money Settlement::getPopulationMoney() const
 {
 	return mPopulation.getMoney();
 }
 
 
-void Settlement::createNewProducers()
+float Settlement::getProductionCost(ProductId prod) const
 {
-	for(auto product : ProductCatalog::getInstance()->getNames()) {
-		auto lim = ProductCatalog::getInstance()->getMaxProduction(product, *mSolarObject);
-		if(lim <= 0.0f)
-			continue;
+	updateProductionCosts();
+	const auto& ids = mSite->Producible;
+	auto it = std::lower_bound(ids.begin(), ids.end(), prod);
+	assert(it != ids.end() && *it == prod);
+	return mProductionCosts[it - ids.begin()];
+}
 
-		auto price = Producer::getProductionPrice(product, mMarket, *mSolarObject);
+void Settlement::updateProductionCosts() const
+{
+	if(mCostEpoch == mMarket.getPriceEpoch())
+		return;
+	mProductionCosts.resize(mSite->Producible.size());
+	for(unsigned int i = 0; i < mSite->Producible.size(); i++)
+		mProductionCosts[i] = Producer::getProductionPrice(mSite->Producible[i], mMarket, *mSite->Object);
+	mCostEpoch = mMarket.getPriceEpoch();
+}
 
-		if(mMarket.getPrice(product) > price) {
-			if(mPopulation.getMoney() > 1000.0f) {
-				mPopulation.removeMoney(1000.0f);
-				auto it = mProducers.find(product);
-				if(it == mProducers.end()) {
-					mProducers[product] = new Producer(product, 1000.0f);
-				} else {
-					it->second->enhance(1000.0f);
+void Settlement::createNewProducers(unsigned int ticks)
+{
+	// one investment per profitable product and tick, as long as the
+	// money lasts
+	updateProductionCosts();
+	for(unsigned int t = 0; t < ticks; t++) {
+		for(unsigned int i = 0; i < mSite->Producible.size(); i++) {
+			auto id = mSite->Producible[i];
+			auto price = mProductionCosts[i];
+
+			if(mMarket.getPrice(id) > price) {
+				if(mPopulation.getMoney() > Money::credits(1000)) {
+					mPopulation.removeMoney(Money::credits(1000));
+					auto it = std::lower_bound(mProducers.begin(), mProducers.end(), id,
+							[] (const Producer& p, ProductId id) { return p.getProductId() < id; });
+					if(it == mProducers.end() || it->getProductId() != id) {
+						mProducers.insert(it, Producer(id, Money::credits(1000)));
+					} else {
+						it->enhance(Money::credits(1000));
+					}
 				}
 			}
 		}
 	}
 }
 
+unsigned int Settlement::getUpdateInterval() const
+{
+	if(mMarket.getVolatility() >= Constants::VolatileMarket)
+		return 1;
+	auto pop = std::max(1u, getPopulation());
+	return std::min(Constants::MaxSettlementInterval,
+			std::max(1u, Constants::FullRatePopulation / pop));
+}
+
+template<typename... Args>
+unsigned int SettlementArena::emplace(SolarObject* obj, Args&&... args)
+{
+	// The arenas and the table reuse the last freed slot, so they agree.
+	// A settlement that fails to construct has freed its market column
+	// already, so only the site is left to give back.
+	auto i = mSites.emplace(obj);
+	try {
+		addSlot(i);
+		auto j = mSettlements.emplace(std::forward<Args>(args)..., &mSites[i], &mMarkets);
+		assert(i == j && mSettlements[j].getMarket()->getColumn() == j);
+		(void)j;
+	} catch(...) {
+		mSites.erase(i);
+		throw;
+	}
+	mSettlements[i].getMarket()->setCallAuction(mCallAuction);
+	return i;
+}
+
+unsigned int SettlementArena::create(SolarObject* obj, unsigned int marketlevel)
+{
+	return emplace(obj, marketlevel);
+}
+
+void SettlementArena::save(unsigned int i, StateWriter& w) const
+{
+	mSettlements[i].save(w);
+	w.write(mQuietUpdates[i]);
+	w.write(mAsleep[i]);
+	w.write(mElapsed[i]);
+	w.write(mIntervals[i]);
+}
+
+unsigned int SettlementArena::load(SolarObject* obj, StateReader& r)
+{
+	auto i = emplace(obj, r);
+	r.read(mQuietUpdates[i]);
+	r.read(mAsleep[i]);
+	r.read(mElapsed[i]);
+	r.read(mIntervals[i]);
+	return i;
+}
+
+void SettlementArena::addSlot(unsigned int i)
+{
+	if(i >= mAsleep.size()) {
+		mQuietUpdates.resize(i + 1);
+		mAsleep.resize(i + 1);
+		mElapsed.resize(i + 1);
+		mIntervals.resize(i + 1);
+	}
+	mQuietUpdates[i] = 0;
+	mAsleep[i] = 0;
+	mElapsed[i] = 0;
+	mIntervals[i] = 1;
+}
+
+void SettlementArena::erase(unsigned int i)
+{
+	mSettlements.erase(i);
+	mSites.erase(i);
+}
+
+void SettlementArena::updatePrices()
+{
+	mDue.clear();
+	for(unsigned int i = 0; i < mSettlements.size(); i++) {
+		if(!mSettlements.contains(i))
+			continue;
+		if(mAsleep[i] && mMarkets.hadForeignTrade(i))
+			wake(i);
+		if(mAsleep[i])
+			continue;
+		// the ticks asleep are skipped and not counted
+		if(++mElapsed[i] >= mIntervals[i])
+			mDue.push_back(i);
+	}
+	mMarkets.updatePrices();
+}
+
+void SettlementArena::wake(unsigned int i)
+{
+	mAsleep[i] = 0;
+	mQuietUpdates[i] = 0;
+	mIntervals[i] = 1;
+}
+
+void SettlementArena::sleep(unsigned int i)
+{
+	mAsleep[i] = 1;
+	mQuietUpdates[i] = Constants::SettlementSleepUpdates;
+}
+
+void SettlementArena::finishUpdate(unsigned int i, bool colonising)
+{
+	bool quiet = !colonising && mSettlements[i].isSettled();
+	mQuietUpdates[i] = quiet ? mQuietUpdates[i] + 1 : 0;
+	if(mQuietUpdates[i] >= Constants::SettlementSleepUpdates)
+		mAsleep[i] = 1;
+
+	// the trade of the update covers its ticks
+	mMarkets.setPriceSteps(i, mElapsed[i]);
+	mElapsed[i] = 0;
+	mIntervals[i] = mSettlements[i].getUpdateInterval();
+}
+
+void SettlementArena::setCallAuction(bool b)
+{
+	mCallAuction = b;
+	for(unsigned int i = 0; i < mSettlements.size(); i++) {
+		if(mSettlements.contains(i)) {
+			mSettlements[i].getMarket()->setCallAuction(b);
+			wake(i);
+		}
+	}
+}
+
+void SettlementArena::clear()
+{
+	mSettlements.clear();
+	mSites.clear();
+	mMarkets.clear();
+	mQuietUpdates.clear();
+	mAsleep.clear();
+	mElapsed.clear();
+	mIntervals.clear();
+	mDue.clear();
+}
 
@@ -4,143 +4,573 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <algorithm>
+#include <cassert>
+#include <climits>
 
 class SolarObject;
+class StateWriter;
+class StateReader;
 
 #include "Constants.h"
+#include "Product.h"
+#include "Arena.h"
+#include "MarketTable.h"
 
-class Storage {
+// Capacity policies for Storage. Ship holds are bounded, everything
+// else can store any number of items.
+class BoundedCapacity {
 	public:
-		Storage(unsigned int maxCapacity);
-		unsigned int items(const std::string& product) const;
-		unsigned int add(const std::string& product, unsigned int num);
-		unsigned int remove(const std::string& product, unsigned int num);
-		unsigned int capacityLeft() const;
-		const std::map<std::string, unsigned int>& getStorage() const { return mStorage; }
-		void clearAll();
-		void clearProduct(const std::string& product);
-		unsigned int getMaxCapacity() const { return mMaxCapacity; }
+		BoundedCapacity(unsigned int maxCapacity) : mMaxCapacity(maxCapacity), mCapacityLeft(maxCapacity) { }
+		unsigned int clamp(unsigned int num) const { return std::min(num, mCapacityLeft); }
+		void added(unsigned int num) { mCapacityLeft -= num; }
+		void removed(unsigned int num) { mCapacityLeft += num; }
+		void reset() { mCapacityLeft = mMaxCapacity; }
+		unsigned int left() const { return mCapacityLeft; }
+		unsigned int getMax() const { return mMaxCapacity; }
+		void save(StateWriter& w) const;
+		void load(StateReader& r);
 
 	private:
 		unsigned int mMaxCapacity;
 		unsigned int mCapacityLeft;
-		std::map<std::string, unsigned int> mStorage;
 };
 
-class Trader {
+class UnboundedCapacity {
+	public:
+		UnboundedCapacity(unsigned int maxCapacity) { assert(maxCapacity == 0); }
+		unsigned int clamp(unsigned int num) const { return num; }
+		void added(unsigned int) { }
+		void removed(unsigned int) { }
+		void reset() { }
+		unsigned int left() const { return UINT_MAX; }
+		unsigned int getMax() const { return 0; }
+		void save(StateWriter&) const { }
+		void load(StateReader&) { }
+};
+
+// Storage layouts. Markets keep their stock in a column of the
+// MarketTable of their system.
+class ColumnLayout {
+	public:
+		// a layout is only usable once bound to a column
+		ColumnLayout() : mTable(nullptr), mColumn(0) { }
+		ColumnLayout(MarketTable* table, unsigned int column) : mTable(table), mColumn(column) { }
+		unsigned int items(ProductId product) const { return mTable->stock(product, mColumn); }
+		void add(ProductId product, unsigned int num) { mTable->stock(product, mColumn) += num; }
+		void remove(ProductId product, unsigned int num) { mTable->stock(product, mColumn) -= num; }
+		void clear()
+		{
+			for(ProductId p = 0; p <= ProductCatalog::getInstance()->getNumProducts(); p++)
+				mTable->stock(p, mColumn) = 0;
+		}
+		template<typename F> void forEach(F f) const
+		{
+			for(ProductId p = 0; p <= ProductCatalog::getInstance()->getNumProducts(); p++) {
+				auto n = items(p);
+				if(n)
+					f(p, n);
+			}
+		}
+		// the stock is saved with the rest of the market column
+		void save(StateWriter&) const { }
+		void load(StateReader&) { }
+
+	private:
+		MarketTable* mTable;
+		unsigned int mColumn;
+};
+
+// Ships and populations only hold one or two products at a time, so
+// they keep a short list that lives inline. Only holding more than
+// InlineSize different products at once allocates.
+class InlineLayout {
+	public:
+		static const unsigned int InlineSize = 2;
+		unsigned int items(ProductId product) const
+		{
+			auto i = find(product);
+			return i < mSize ? at(i).Count : 0;
+		}
+		void add(ProductId product, unsigned int num);
+		void remove(ProductId product, unsigned int num);
+		void clear() { mSize = 0; mOverflow.clear(); }
+		// visits the items last to first, so f may remove the current item
+		template<typename F> void forEach(F f) const
+		{
+			for(auto i = mSize; i-- > 0; ) {
+				auto item = at(i);
+				f(item.Product, item.Count);
+			}
+		}
+		void save(StateWriter& w) const;
+		void load(StateReader& r);
+
+	private:
+		struct Item {
+			ProductId Product;
+			unsigned int Count;
+		};
+
+		unsigned int find(ProductId product) const
+		{
+			unsigned int i = 0;
+			while(i < mSize && at(i).Product != product)
+				i++;
+			return i;
+		}
+		const Item& at(unsigned int i) const { return i < InlineSize ? mInline[i] : mOverflow[i - InlineSize]; }
+		Item& at(unsigned int i) { return i < InlineSize ? mInline[i] : mOverflow[i - InlineSize]; }
+
+		Item mInline[InlineSize];
+		unsigned int mSize = 0;
+		std::vector<Item> mOverflow;
+};
+
+template<typename Capacity, typename Layout>
+class Storage {
 	public:
-		Trader(float money, unsigned int storage);
-		float getMoney() const;
-		void addMoney(float val);
-		float removeMoney(float val);
-		unsigned int buy(const std::string& product, unsigned int number, float price, Trader& buyer);
-		unsigned int sell(const std::string& product, unsigned int number, float price, Trader& seller);
+		Storage(unsigned int maxCapacity, const Layout& layout = Layout()) : mCapacity(maxCapacity), mItems(layout) { }
+		unsigned int items(ProductId product) const { return mItems.items(product); }
+		unsigned int add(ProductId product, unsigned int num)
+		{
+			num = mCapacity.clamp(num);
+			if(num) {
+				mItems.add(product, num);
+				mCapacity.added(num);
+			}
+			return num;
+		}
+		unsigned int remove(ProductId product, unsigned int num)
+		{
+			num = std::min(num, mItems.items(product));
+			if(num) {
+				mItems.remove(product, num);
+				mCapacity.removed(num);
+			}
+			return num;
+		}
+		unsigned int capacityLeft() const { return mCapacity.left(); }
+		unsigned int getMaxCapacity() const { return mCapacity.getMax(); }
+		const Layout& getLayout() const { return mItems; }
+		template<typename F> void forEachItem(F f) const { mItems.forEach(f); }
+		void clearAll()
+		{
+			mItems.clear();
+			mCapacity.reset();
+		}
+		void clearProduct(ProductId product) { remove(product, items(product)); }
+		void save(StateWriter& w) const
+		{
+			mCapacity.save(w);
+			mItems.save(w);
+		}
+		void load(StateReader& r)
+		{
+			mCapacity.load(r);
+			mItems.load(r);
+		}
+
+	private:
+		Capacity mCapacity;
+		Layout mItems;
+};
+
+typedef Storage<UnboundedCapacity, ColumnLayout> MarketStorage;
+typedef Storage<UnboundedCapacity, InlineLayout> HoldStorage;
+typedef Storage<BoundedCapacity, InlineLayout> CargoStorage;
+
+// tag for traders that can pay any amount
+struct InfiniteFunds { };
+
+// The member functions are defined in Settlement.cpp and explicitly
+// instantiated for the trader types below.
+template<typename S>
+class BasicTrader {
+	public:
+		BasicTrader(Money money, unsigned int storage);
+		BasicTrader(Money money, const S& storage);
+		BasicTrader(InfiniteFunds, unsigned int storage);
+		// copies the money of t, with new storage
+		BasicTrader(const BasicTrader& t, const S& storage);
+		void copyMoney(const BasicTrader& t) { mMoney = t.mMoney; mInfinite = t.mInfinite; }
+		// Money::max() for a trader with infinite funds; adding to it
+		// overflows, so check hasInfiniteFunds() before summing
+		Money getMoney() const;
+		bool hasInfiniteFunds() const { return mInfinite; }
+		void addMoney(Money val);
+		void removeMoney(Money val);
+		// price is per item
+		template<typename T>
+		unsigned int buy(ProductId product, unsigned int number, Money price, T& buyer);
+		template<typename T>
+		unsigned int sell(ProductId product, unsigned int number, Money price, T& seller)
+		{
+			return seller.buy(product, number, price, *this);
+		}
+		unsigned int addToStorage(ProductId product, unsigned int number) { return mStorage.add(product, number); }
 		unsigned int addToStorage(const std::string& product, unsigned int number);
+		unsigned int removeFromStorage(ProductId product, unsigned int number) { return mStorage.remove(product, number); }
 		unsigned int removeFromStorage(const std::string& product, unsigned int number);
-		unsigned int storageLeft() const;
+		unsigned int storageLeft() const { return mStorage.capacityLeft(); }
 		unsigned int getMaxCapacity() const { return mStorage.getMaxCapacity(); }
-		const std::map<std::string, unsigned int>& getStorage() const { return mStorage.getStorage(); }
+		const S& getStorage() const { return mStorage; }
+		// calls f(product, count) for each product held; f may sell or
+		// remove the product it is called for
+		template<typename F> void forEachItem(F f) const { mStorage.forEachItem(f); }
+		unsigned int items(ProductId product) const { return mStorage.items(product); }
 		unsigned int items(const std::string& product) const;
-		void clearAll();
+		void clearAll() { mStorage.clearAll(); }
+		void clearProduct(ProductId product) { mStorage.clearProduct(product); }
 		void clearProduct(const std::string& product);
+		void save(StateWriter& w) const;
+		void load(StateReader& r);
 
 	private:
-		float mMoney;
-		Storage mStorage;
+		Money mMoney;
+		bool mInfinite = false;
+		S mStorage;
 };
 
+typedef BasicTrader<MarketStorage> MarketTrader;
+// populations, producers and the aggregate fleets
+typedef BasicTrader<HoldStorage> Trader;
+typedef BasicTrader<CargoStorage> ShipTrader;
+
+// A market of a settlement. Its prices and stock live in a column of a
+// MarketTable, the money in the market itself.
+//
+// In call auction mode the settlement tick does not trade directly but
+// posts its orders with postBuy() and postSell(), and clearOrders()
+// fills them all at once at the market price. Sells are filled before
+// buys. If the stock of a product (for buys) or the money of the market
+// (for sells) does not cover all orders, every order gets the same share,
+// rounded down, so the result does not depend on the order of the calls.
+// The buys of one party are limited to its money together, with its
+// earlier orders served first. The orders carry no limit prices, so
+// there is no clearing price to find: the market is the other side of
+// every order, and the price update after the tick reacts to the
+// imbalance as it does for direct trades.
 class Market {
 	public:
-		Market(float money);
+		static const unsigned int NoOrder = UINT_MAX;
+
+		Market(MarketTable* table, Money money);
+		// copies the market into a new column of the given table
+		Market(const Market& m, MarketTable* table);
+		// frees the column
+		~Market();
+		// overwrites the market with m, keeping its own column
+		void copyState(const Market& m);
+		Market(const Market&) = delete;
+		Market(const Market&&) = delete;
+		Market& operator=(const Market&) & = delete;
+		Market& operator=(Market&&) & = delete;
+		float getPrice(ProductId product) const { return mTable->price(product, mColumn); }
 		float getPrice(const std::string& product) const;
+		// see MarketTable::getEpoch()
+		uint64_t getPriceEpoch() const { return mTable->getEpoch(); }
+		// column in the market table
+		unsigned int getColumn() const { return mColumn; }
+		// the price as charged in trades
+		Money getTradePrice(ProductId product) const { return Money::fromCredits(getPrice(product)); }
+		unsigned int items(ProductId product) const { return mTrader.items(product); }
 		unsigned int items(const std::string& product) const;
-		float getMoney() const;
-		void addMoney(float val);
-		const std::map<std::string, unsigned int>& getStorage() const { return mTrader.getStorage(); }
+		Money getMoney() const;
+		void addMoney(Money val);
+		void removeMoney(Money val);
+		// whether the product has ever been in stock here
+		bool isListed(ProductId product) const { return mTable->listed(product, mColumn); }
+		// see MarketTable::getVolatility()
+		float getVolatility() const { return mTable->getVolatility(mColumn); }
+		// instantiated for Trader and ShipTrader
+		template<typename T>
+		unsigned int buy(ProductId product, unsigned int number,
+				T& buyer, Econ::Entity ent, const SolarObject* solarObject);
+		template<typename T>
 		unsigned int buy(const std::string& product, unsigned int number,
-				Trader& buyer, Econ::Entity ent, const SolarObject* solarObject);
+				T& buyer, Econ::Entity ent, const SolarObject* solarObject);
+		template<typename T>
+		unsigned int sell(ProductId product, unsigned int number,
+				T& seller, Econ::Entity ent, const SolarObject* solarObject);
+		template<typename T>
 		unsigned int sell(const std::string& product, unsigned int number,
+				T& seller, Econ::Entity ent, const SolarObject* solarObject);
+		const MarketTrader& getTrader() const { return mTrader; }
+		void setCallAuction(bool b) { mCallAuction = b; }
+		bool isCallAuction() const { return mCallAuction; }
+		// return the order index; buys are limited to what the buyer can
+		// pay on top of its earlier buys in the auction
+		unsigned int postBuy(ProductId product, unsigned int number,
+				Trader& buyer, Econ::Entity ent, const SolarObject* solarObject);
+		unsigned int postSell(ProductId product, unsigned int number,
 				Trader& seller, Econ::Entity ent, const SolarObject* solarObject);
-		const Trader& getTrader() const { return mTrader; }
-		void updatePrices();
+		void clearOrders();
+		// items traded by an order of the last clearOrders()
+		unsigned int getFilled(unsigned int order) const { return mOrders[order].Filled; }
 		unsigned int fixLabour();
+		void save(StateWriter& w) const;
+		void load(StateReader& r);
 
 	private:
-		std::map<std::string, float> mPrices;
-		Trader mTrader;
-		std::map<std::string, int> mSurplus;
+		struct Order {
+			ProductId Product;
+			unsigned int Number;
+			bool Sell;
+			Trader* Party;
+			Econ::Entity Entity;
+			const SolarObject* Object;
+			unsigned int Filled;
+		};
+
+		// drops the orders of the last auction once it is cleared
+		void beginOrders();
+		unsigned int post(const Order& o);
+
+		MarketTable* mTable;
+		unsigned int mColumn;
+		MarketTrader mTrader;
+		bool mCallAuction = false;
+		// the orders of the current or last auction
+		std::vector<Order> mOrders;
+		bool mCleared = false;
 };
 
 class Population {
 	public:
-		Population(unsigned int num, float money, const SolarObject* obj);
-		bool update(Market& m);
-		float getMoney() const;
-		void addMoney(float val);
-		void removeMoney(float m);
+		// money is per citizen
+		Population(unsigned int num, Money money, const SolarObject* obj);
+		// consumption, growth and labour of the given number of ticks
+		bool update(Market& m, unsigned int ticks);
+		Money getMoney() const;
+		void addMoney(Money val);
+		void removeMoney(Money m);
 		unsigned int getNum() const;
 		void removePop(unsigned int num);
 		void addPop(unsigned int num);
+		// call auction version of update(): posts the orders of the tick,
+		// then applies the result once the market is cleared
+		void postOrders(Market& m, unsigned int ticks);
+		bool settleOrders(const Market& m, unsigned int ticks);
+		// luxuries go to the next auction, only once the staples are known
+		// to suffice
+		void postLuxuries(Market& m, unsigned int ticks);
+		void settleLuxuries();
+		void save(StateWriter& w) const;
+		void load(StateReader& r);
 
 	private:
-		bool consume(Market& m);
-		void work(Market& m);
+		bool consume(Market& m, unsigned int ticks);
+		bool eat(const Market& m, unsigned int needed, unsigned int bought, unsigned int ticks);
+		void work(Market& m, unsigned int ticks);
 		unsigned int calculateConsumption(float coeff) const;
 
 		unsigned int mNum;
 		Trader mTrader;
 		const SolarObject* mSolarObject;
+		unsigned int mStapleNeeded = 0;
+		unsigned int mStapleOrder = Market::NoOrder;
 };
 
 class Settlement;
 
 class Producer {
 	public:
-		Producer(const std::string& prod, unsigned int money);
-		void enhance(float money);
-		float deenhance();
-		void addMoney(float val);
-		void removeMoney(float val);
-		float getMoney() const;
-		unsigned int produce(Market& m, const Settlement& settlement);
-		const std::string& getProduct() const { return mProduct; }
+		Producer(ProductId product, Money money);
+		Producer(StateReader& r);
+		void enhance(Money money);
+		Money deenhance();
+		void addMoney(Money val);
+		void removeMoney(Money val);
+		Money getMoney() const;
+		// production of the given number of ticks
+		unsigned int produce(Market& m, const Settlement& settlement, unsigned int ticks);
+		// call auction version of produce(), in three steps around the
+		// two market clearings of the tick
+		void postInputs(Market& m, const Settlement& settlement, unsigned int ticks);
+		void postOutputs(Market& m, const Settlement& settlement, unsigned int ticks);
+		unsigned int settleOrders(const Market& m, const Settlement& settlement);
+		const std::string& getProduct() const { return ProductCatalog::getInstance()->getName(mProductId); }
+		ProductId getProductId() const { return mProductId; }
 		unsigned int getLevel() const { return mLevel; }
-		static float getProductionPrice(const std::string& product, const Market& m, const SolarObject& obj);
+		static float getProductionPrice(ProductId product, const Market& m, const SolarObject& obj);
+		void save(StateWriter& w) const;
 
 	private:
-		std::string mProduct;
+		// false if producing does not pay
+		bool plan(const Market& m, const Settlement& settlement, unsigned int ticks,
+				unsigned int& wantProduce) const;
+		// turns the inputs held into the product
+		void make(const Settlement& settlement, unsigned int ticks);
+
+		ProductId mProductId;
 		Trader mTrader;
 		unsigned int mLevel = 1;
+		bool mPlanned = false;
+		unsigned int mWantProduce = 0;
+		unsigned int mOutputOrder = Market::NoOrder;
+};
+
+// The part of a settlement that only depends on the object it is on.
+// It is not touched by trade, so forks share it and paging does not
+// save it.
+struct SettlementSite {
+	SettlementSite(SolarObject* obj);
+	SolarObject* Object;
+	// maximum production of each product on this object
+	PerProduct<float> MaxProduction;
+	// products with a non-zero maximum production
+	std::vector<ProductId> Producible;
 };
 
 class Settlement {
 	public:
-		Settlement(unsigned int marketlevel, const SolarObject* obj);
+		Settlement(unsigned int marketlevel, const SettlementSite* site, MarketTable* markets);
+		Settlement(StateReader& r, const SettlementSite* site, MarketTable* markets);
 		~Settlement();
-		Settlement(const Settlement&) = delete;
 		Settlement(const Settlement&&) = delete;
 		Settlement& operator=(const Settlement&) & = delete;
 		Settlement& operator=(Settlement&&) & = delete;
 		Market* getMarket() { return &mMarket; }
 		const Market* getMarket() const { return &mMarket; }
 		// NOTE: do not expose non-const Trader to ensure all buy/sell goes through the market.
-		const Trader& getTrader() const { return mMarket.getTrader(); }
-		bool update();
+		const MarketTrader& getTrader() const { return mMarket.getTrader(); }
+		// Runs the given number of ticks in one update, with consumption,
+		// labour and production scaled to them. Returns whether the
+		// settlement wants to found a new one.
+		bool update(unsigned int ticks = 1);
+		// ticks until the next update, fewer for large settlements and
+		// those whose prices move
+		unsigned int getUpdateInterval() const;
 		unsigned int getPopulation() const;
 		Population* getPopulationObj() { return &mPopulation; }
-		float getPopulationMoney() const;
-		const std::map<std::string, Producer*>& getProducers() const { return mProducers; }
+		Money getPopulationMoney() const;
+		// sorted by product
+		const std::vector<Producer>& getProducers() const { return mProducers; }
 		float getHappiness() const { return mHappiness; }
-		const SolarObject* getSolarObject() const { return mSolarObject; }
+		const SolarObject* getSolarObject() const { return mSite->Object; }
+		float getMaxProduction(ProductId prod) const { return mSite->MaxProduction[prod]; }
+		// enough people and money to found a new settlement
+		bool canColonise() const;
+		// too few people left to keep the settlement going
+		bool isAbandoned() const { return getPopulation() <= Constants::MinSettlementPopulation; }
+		// the last update had no famine, changed neither the population
+		// nor the levels of the producers, and hardly changed the money
+		// and stock of the market, whose prices are not volatile
+		bool isSettled() const { return mSettled; }
+		// removes and returns the money of the people, the market and the
+		// producers, for when the settlement is abandoned
+		Money takeAllMoney();
+		// input cost of one unit of a producible product at the current
+		// prices, computed once per price epoch
+		float getProductionCost(ProductId prod) const;
+		// deep copy used by Econ::Fork and EconSnapshot, with the market
+		// in the given table. The copy has a site of its own, so it stays
+		// valid when the original is erased or paged out.
+		Settlement* clone(MarketTable* markets) const;
+		// overwrites a clone with the state of a settlement on the same
+		// object, reusing its market column and storage
+		void copyState(const Settlement& s);
+		void save(StateWriter& w) const;
 
 	private:
-		void createNewProducers();
+		Settlement(const Settlement& s, MarketTable* markets);
+		// the trade of an update; return whether there was a famine
+		bool trade(unsigned int ticks);
+		bool tradeByAuction(unsigned int ticks);
+		void checkProducer(Producer& p, unsigned int sold, unsigned int ticks);
+		void createNewProducers(unsigned int ticks);
+		void updateProductionCosts() const;
+		unsigned int getProducerLevels() const;
+		uint64_t getMarketStock() const;
 
 		Market mMarket;
 		Population mPopulation;
-		std::map<std::string, Producer*> mProducers;
-		const SolarObject* mSolarObject;
+		std::vector<Producer> mProducers;
 		float mHappiness = 1.0f;
+		bool mSettled = false;
+		// owned by clones only, see clone()
+		SettlementSite* mOwnSite = nullptr;
+		const SettlementSite* mSite;
+		// by the index in mSite->Producible
+		mutable std::vector<float> mProductionCosts;
+		mutable uint64_t mCostEpoch = 0;
+};
+
+// Owns the settlements of a solar system. The per-tick state and the
+// sites are kept in separate arenas under the same index, so a tick
+// over all settlements reads them in order from memory. The market of
+// each settlement is the column of the same index in the market table.
+// The slots of erased settlements are reused by the next one created.
+//
+// Each settlement is due for an update every getUpdateInterval() ticks
+// and then runs all the ticks since its last update at once. This is
+// close to but not the same as running the ticks one by one: the
+// settlement trades once, for all the ticks, at the prices of the first,
+// so a famine or a sale covers all of them; and the traded prices of its
+// market then take one step per tick in the direction of the combined
+// trade (see MarketTable::setPriceSteps()).
+//
+// A settlement that has stayed settled (see Settlement::isSettled()) for
+// Constants::SettlementSleepUpdates updates only repeats the same trade
+// with its own market and is put to sleep: it is left out of getDue(),
+// and its market keeps its stock and prices, until a ship or a fleet
+// trades there or wake() brings it back.
+class SettlementArena {
+	public:
+		static const unsigned int None = UINT_MAX;
+
+		unsigned int create(SolarObject* obj, unsigned int marketlevel);
+		// the settlement and its schedule, including whether it sleeps
+		void save(unsigned int i, StateWriter& w) const;
+		unsigned int load(SolarObject* obj, StateReader& r);
+		// frees the settlement, its site and, with the market, its column
+		void erase(unsigned int i);
+		bool isLive(unsigned int i) const { return mSettlements.contains(i); }
+		Settlement& get(unsigned int i) { return mSettlements[i]; }
+		const Settlement& get(unsigned int i) const { return mSettlements[i]; }
+		SolarObject* getObject(unsigned int i) { return mSites[i].Object; }
+		// number of slots, live or erased
+		unsigned int size() const { return mSettlements.size(); }
+		// The price update of all markets, run before the settlements.
+		// Wakes the settlements whose market a ship or a fleet traded in
+		// since the last update and renews getDue().
+		void updatePrices();
+		// awake settlements due for an update in index order, as of the
+		// last updatePrices()
+		const std::vector<unsigned int>& getDue() const { return mDue; }
+		// ticks to run in the next update of a settlement
+		unsigned int getElapsed(unsigned int i) const { return mElapsed[i]; }
+		// also makes the settlement due on the next tick
+		void wake(unsigned int i);
+		// as if the settlement had stayed settled, until it is woken
+		void sleep(unsigned int i);
+		// To be called after each update of a settlement. Checks whether
+		// it has gone quiet and schedules its next update.
+		void finishUpdate(unsigned int i, bool colonising);
+		bool isAsleep(unsigned int i) const { return mAsleep[i]; }
+		// switches all markets, present and future, to call auctions
+		void setCallAuction(bool b);
+		void clear();
+
+	private:
+		// creates the site and the settlement, both or neither
+		template<typename... Args>
+		unsigned int emplace(SolarObject* obj, Args&&... args);
+		void addSlot(unsigned int i);
+
+		MarketTable mMarkets;
+		bool mCallAuction = false;
+		Arena<SettlementSite> mSites;
+		Arena<Settlement> mSettlements;
+
+		// by settlement index
+		std::vector<unsigned int> mQuietUpdates;
+		std::vector<unsigned char> mAsleep;
+		// awake ticks since the last update and ticks between updates
+		std::vector<unsigned int> mElapsed;
+		std::vector<unsigned int> mIntervals;
+		std::vector<unsigned int> mDue;
 };
 
 #endif
@@ -0,0 +1,132 @@
+#include <cmath>
+
+#include "ShipPhysics.h"
+#include "SolarSystem.h"
+#include "SolarObject.h"
+#include "Constants.h"
+
+namespace {
+	// speed and acceleration limits of a ship
+	const float MaxSpeed = 10000000.0f;
+	const float MaxAcceleration = 10000000.0f;
+
+	// scale factor that limits a vector of the given squared length
+	inline float limit(float len2, float max)
+	{
+		return len2 > max * max ? max / sqrtf(len2) : 1.0f;
+	}
+
+	// Semi-implicit Euler step. The loop has no branches and the arrays
+	// are marked as not overlapping so that it can be vectorised. This
+	// also needs -fno-math-errno and -fno-trapping-math, see CMakeLists.txt.
+	void integrateShips(size_t n, float time,
+			float* __restrict posX, float* __restrict posY,
+			float* __restrict velX, float* __restrict velY,
+			const float* __restrict accX, const float* __restrict accY,
+			float* __restrict rot, const float* __restrict rotVel,
+			const unsigned char* __restrict flying)
+	{
+		for(size_t i = 0; i < n; i++) {
+			float dt = time * flying[i];
+			float ax = accX[i];
+			float ay = accY[i];
+			float sa = limit(ax * ax + ay * ay, MaxAcceleration);
+			float vx = velX[i] + ax * sa * dt;
+			float vy = velY[i] + ay * sa * dt;
+			float sv = limit(vx * vx + vy * vy, MaxSpeed);
+			vx *= sv;
+			vy *= sv;
+			velX[i] = vx;
+			velY[i] = vy;
+			posX[i] += vx * dt;
+			posY[i] += vy * dt;
+			rot[i] += rotVel[i] * dt;
+		}
+	}
+}
+
+void ShipPhysics::add(unsigned int i, float enginePower, float sidePower)
+{
+	if(i >= mPosX.size()) {
+		auto n = i + 1;
+		mPosX.resize(n);
+		mPosY.resize(n);
+		mVelX.resize(n);
+		mVelY.resize(n);
+		mAccX.resize(n);
+		mAccY.resize(n);
+		mRot.resize(n);
+		mRotVel.resize(n);
+		mFlying.resize(n);
+		mThrust.resize(n);
+		mSideThrust.resize(n);
+		mEnginePower.resize(n);
+		mSidePower.resize(n);
+		mAlive.resize(n);
+	}
+	mPosX[i] = mPosY[i] = 0.0f;
+	mVelX[i] = mVelY[i] = 0.0f;
+	mAccX[i] = mAccY[i] = 0.0f;
+	mRot[i] = mRotVel[i] = 0.0f;
+	mFlying[i] = 1;
+	mThrust[i] = mSideThrust[i] = 0.0f;
+	mEnginePower[i] = enginePower;
+	mSidePower[i] = sidePower;
+	mAlive[i] = 1;
+}
+
+void ShipPhysics::remove(unsigned int i)
+{
+	mFlying[i] = 0;
+	mAlive[i] = 0;
+	mVelX[i] = mVelY[i] = 0.0f;
+	mAccX[i] = mAccY[i] = 0.0f;
+	mRotVel[i] = 0.0f;
+}
+
+void ShipPhysics::accelerate(const SolarSystem* system)
+{
+	mBodyX.clear();
+	mBodyY.clear();
+	mBodyMass.clear();
+	float thrustScale = 1.0f;
+	if(system) {
+		thrustScale = Constants::SolarSystemSpeedCoefficient;
+		for(auto obj : system->getObjects()) {
+			auto pos = obj->getPosition();
+			mBodyX.push_back(pos.x);
+			mBodyY.push_back(pos.y);
+			mBodyMass.push_back(1e+6f * obj->getMass());
+		}
+	}
+
+	auto numBodies = mBodyX.size();
+	for(unsigned int i = 0; i < mPosX.size(); i++) {
+		if(!mAlive[i] || !mFlying[i])
+			continue;
+
+		// the pull of each object is proportional to its mass and
+		// inversely proportional to the distance
+		float ax = 0.0f;
+		float ay = 0.0f;
+		for(unsigned int j = 0; j < numBodies; j++) {
+			float dx = mBodyX[j] - mPosX[i];
+			float dy = mBodyY[j] - mPosY[i];
+			float d2 = dx * dx + dy * dy;
+			float f = d2 > 0.0f ? mBodyMass[j] / d2 : 0.0f;
+			ax += dx * f;
+			ay += dy * f;
+		}
+
+		float th = mThrust[i] * thrustScale * mEnginePower[i];
+		mAccX[i] = ax + th * cosf(mRot[i]);
+		mAccY[i] = ay + th * sinf(mRot[i]);
+		mRotVel[i] = mSidePower[i] * mSideThrust[i];
+	}
+}
+
+void ShipPhysics::integrate(float time)
+{
+	integrateShips(mPosX.size(), time, mPosX.data(), mPosY.data(), mVelX.data(), mVelY.data(),
+			mAccX.data(), mAccY.data(), mRot.data(), mRotVel.data(), mFlying.data());
+}
@@ -0,0 +1,65 @@
+#ifndef SR3_SHIPPHYSICS_H
+#define SR3_SHIPPHYSICS_H
+
+#include <vector>
+
+#include "common/Entity.h"
+
+class SolarSystem;
+
+// The per-frame physics state of a set of ships, kept as one array per
+// field and indexed by the slot of the ship. The rest of a ship stays in
+// its SpaceShip object. Free slots are left in place and never move.
+class ShipPhysics {
+	public:
+		// makes room for slot i and resets its state
+		void add(unsigned int i, float enginePower, float sidePower);
+		void remove(unsigned int i);
+
+		Common::Vector3 getPosition(unsigned int i) const { return Common::Vector3(mPosX[i], mPosY[i], 0.0f); }
+		void setPosition(unsigned int i, const Common::Vector3& v) { mPosX[i] = v.x; mPosY[i] = v.y; }
+		Common::Vector3 getVelocity(unsigned int i) const { return Common::Vector3(mVelX[i], mVelY[i], 0.0f); }
+		float getRotation(unsigned int i) const { return mRot[i]; }
+		float getThrust(unsigned int i) const { return mThrust[i]; }
+		void setThrust(unsigned int i, float f) { mThrust[i] = f; }
+		float getSideThrust(unsigned int i) const { return mSideThrust[i]; }
+		void setSideThrust(unsigned int i, float f) { mSideThrust[i] = f; }
+		float getEnginePower(unsigned int i) const { return mEnginePower[i]; }
+		bool isAlive(unsigned int i) const { return mAlive[i]; }
+		void setAlive(unsigned int i, bool b) { mAlive[i] = b; }
+		// landed ships are not moved
+		void setFlying(unsigned int i, bool b) { mFlying[i] = b; }
+
+		// Sets the acceleration of the living, flying ships from their
+		// engines and, if a system is given, the gravity of its objects.
+		// Other ships keep their last acceleration.
+		void accelerate(const SolarSystem* system);
+		// moves the flying ships
+		void integrate(float time);
+
+	private:
+		std::vector<float> mPosX;
+		std::vector<float> mPosY;
+		std::vector<float> mVelX;
+		std::vector<float> mVelY;
+		std::vector<float> mAccX;
+		std::vector<float> mAccY;
+		std::vector<float> mRot;
+		std::vector<float> mRotVel;
+		std::vector<unsigned char> mFlying;
+
+		// inputs of accelerate()
+		std::vector<float> mThrust;
+		std::vector<float> mSideThrust;
+		std::vector<float> mEnginePower;
+		std::vector<float> mSidePower;
+		std::vector<unsigned char> mAlive;
+
+		// positions and masses of the attracting objects
+		std::vector<float> mBodyX;
+		std::vector<float> mBodyY;
+		std::vector<float> mBodyMass;
+};
+
+#endif
+
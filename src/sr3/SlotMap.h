@@ -0,0 +1,155 @@
+#ifndef SR3_SLOTMAP_H
+#define SR3_SLOTMAP_H
+
+#include <vector>
+#include <new>
+#include <utility>
+#include <climits>
+#include <cassert>
+
+// Objects in fixed size blocks, addressed by handles that carry the
+// generation of their slot. A handle to an erased object no longer
+// resolves, even after the slot has been reused. Freed slots are reused
+// before new ones are added, so memory only grows with the peak number
+// of live objects.
+template<typename T, unsigned int BlockSize = 64>
+class SlotMap {
+	public:
+		struct Handle {
+			unsigned int Index = UINT_MAX;
+			unsigned int Generation = 0;
+			bool operator==(const Handle& h) const { return Index == h.Index && Generation == h.Generation; }
+			bool operator!=(const Handle& h) const { return !(*this == h); }
+		};
+
+		SlotMap() = default;
+		~SlotMap() { clear(); }
+		SlotMap(const SlotMap&) = delete;
+		SlotMap(const SlotMap&&) = delete;
+		SlotMap& operator=(const SlotMap&) & = delete;
+		SlotMap& operator=(SlotMap&&) & = delete;
+
+		// The slot is only taken once the object is constructed, so a
+		// throwing constructor leaves the map as it was.
+		template<typename... Args>
+		Handle emplace(Args&&... args)
+		{
+			bool fresh = mFree.empty();
+			unsigned int i = fresh ? mGenerations.size() : mFree.back();
+			if(fresh) {
+				if(i == mBlocks.size() * BlockSize) {
+					auto b = static_cast<T*>(::operator new(sizeof(T) * BlockSize));
+					try {
+						mBlocks.push_back(b);
+					} catch(...) {
+						::operator delete(b);
+						throw;
+					}
+				}
+				mGenerations.push_back(0);
+			}
+			try {
+				new(slot(i)) T(std::forward<Args>(args)...);
+			} catch(...) {
+				if(fresh)
+					mGenerations.pop_back();
+				throw;
+			}
+			if(!fresh)
+				mFree.pop_back();
+			// odd generations are live
+			mGenerations[i]++;
+			mSize++;
+			Handle h;
+			h.Index = i;
+			h.Generation = mGenerations[i];
+			return h;
+		}
+
+		void erase(Handle h)
+		{
+			assert(contains(h));
+			slot(h.Index)->~T();
+			mGenerations[h.Index]++;
+			mFree.push_back(h.Index);
+			mSize--;
+		}
+
+		bool contains(Handle h) const
+		{
+			return h.Index < mGenerations.size() && mGenerations[h.Index] == h.Generation;
+		}
+
+		T* get(Handle h) { return contains(h) ? slot(h.Index) : nullptr; }
+		const T* get(Handle h) const { return contains(h) ? slot(h.Index) : nullptr; }
+
+		// number of live objects
+		unsigned int size() const { return mSize; }
+		// number of slots, live or free
+		unsigned int capacity() const { return mGenerations.size(); }
+		// slot that the next emplace() will use
+		unsigned int nextIndex() const { return mFree.empty() ? mGenerations.size() : mFree.back(); }
+
+		// Iterates the live objects in slot order. Erasing the object an
+		// iterator points to does not invalidate the iterator.
+		template<typename M, typename V>
+		class Iterator {
+			public:
+				Iterator(M* map, unsigned int i) : mMap(map), mIndex(i) { skip(); }
+				V& operator*() const { return *mMap->slot(mIndex); }
+				V* operator->() const { return mMap->slot(mIndex); }
+				Iterator& operator++() { mIndex++; skip(); return *this; }
+				bool operator!=(const Iterator& it) const { return mIndex != it.mIndex; }
+				bool operator==(const Iterator& it) const { return mIndex == it.mIndex; }
+				Handle handle() const
+				{
+					Handle h;
+					h.Index = mIndex;
+					h.Generation = mMap->mGenerations[mIndex];
+					return h;
+				}
+
+			private:
+				void skip()
+				{
+					while(mIndex < mMap->mGenerations.size() && !(mMap->mGenerations[mIndex] & 1))
+						mIndex++;
+				}
+
+				M* mMap;
+				unsigned int mIndex;
+		};
+		typedef Iterator<SlotMap, T> iterator;
+		typedef Iterator<const SlotMap, const T> const_iterator;
+
+		iterator begin() { return iterator(this, 0); }
+		iterator end() { return iterator(this, mGenerations.size()); }
+		const_iterator begin() const { return const_iterator(this, 0); }
+		const_iterator end() const { return const_iterator(this, mGenerations.size()); }
+
+		void clear()
+		{
+			for(unsigned int i = mGenerations.size(); i-- > 0; ) {
+				if(mGenerations[i] & 1)
+					slot(i)->~T();
+			}
+			for(auto b : mBlocks)
+				::operator delete(b);
+			mBlocks.clear();
+			mGenerations.clear();
+			mFree.clear();
+			mSize = 0;
+		}
+
+	private:
+		T* slot(unsigned int i) { return &mBlocks[i / BlockSize][i % BlockSize]; }
+		const T* slot(unsigned int i) const { return &mBlocks[i / BlockSize][i % BlockSize]; }
+
+		std::vector<T*> mBlocks;
+		std::vector<unsigned int> mGenerations;
+		std::vector<unsigned int> mFree;
+		unsigned int mSize = 0;
+};
+
+#endif
+
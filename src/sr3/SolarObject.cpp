@@ -11,14 +11,8 @@ SolarObject::SolarObject(const std::string& name, float size, float mass)
 {
 }
 
-SolarObject::~SolarObject()
-{
-	if(mSettlement)
-		delete mSettlement;
-}
-
-SolarObject::SolarObject(const SolarObject* center, const std::string& name, SOType type,
-		float size, float mass, float orbit, float speed, unsigned int marketlevel)
+SolarObject::SolarObject(SettlementArena* settlements, const SolarObject* center, const std::string& name,
+		SOType type, float size, float mass, float orbit, float speed, unsigned int marketlevel)
 	: mName(name),
 	mSize(size),
 	mMass(mass),
@@ -26,10 +20,11 @@ SolarObject::SolarObject(const SolarObject* center, const std::string& name, SOT
 	mOrbitPosition(rand() % 100 * 0.01f),
 	mSpeed(speed * 0.002f),
 	mCenter(center),
-	mObjectType(type)
+	mObjectType(type),
+	mSettlements(settlements)
 {
 	if(marketlevel > 0) {
-		mSettlement = new Settlement(marketlevel, this);
+		mSettlement = mSettlements->create(this, marketlevel);
 	}
 	update(0.0f);
 }
@@ -47,59 +42,60 @@ bool SolarObject::canBeColonised() const
 	return mMass < 10.0f && mObjectType != SOType::Star && mObjectType != SOType::GasGiant;
 }
 
-bool SolarObject::updateSettlement()
-{
-	if(mSettlement) {
-		return mSettlement->update();
-	} else {
-		return false;
-	}
-}
-
 Settlement* SolarObject::getOrCreateSettlement()
 {
-	if(!mSettlement)
-		mSettlement = new Settlement(0, this);
-	return mSettlement;
+	assert(mSettlements);
+	if(!hasSettlement())
+		mSettlement = mSettlements->create(this, 0);
+	return getSettlement();
 }
 
 void SolarObject::colonise(SolarObject* target)
 {
 	auto newSettlement = target->getOrCreateSettlement();
-	auto havePop = mSettlement->getPopulation();
+	mSettlements->wake(target->getSettlementIndex());
+	auto settlement = getSettlement();
+	auto havePop = settlement->getPopulation();
 	assert(havePop >= Constants::MinPopulationForColonisation);
 	auto popMigration = (unsigned int)(havePop * Constants::PercentagePopulationColonised);
-	mSettlement->getPopulationObj()->removePop(popMigration);
+	settlement->getPopulationObj()->removePop(popMigration);
 	newSettlement->getPopulationObj()->addPop(popMigration);
-	assert(mSettlement->getPopulationMoney() >= Constants::MinPopulationMoneyForColonisation);
-	auto moneyMigration = mSettlement->getPopulationMoney() * Constants::PercentagePopulationColonised;
-	mSettlement->getPopulationObj()->removeMoney(moneyMigration);
+	assert(settlement->getPopulationMoney() >= Constants::MinPopulationMoneyForColonisation);
+	auto moneyMigration = settlement->getPopulationMoney().scale(Constants::PercentagePopulationColonised);
+	settlement->getPopulationObj()->removeMoney(moneyMigration);
 	newSettlement->getPopulationObj()->addMoney(moneyMigration);
 	printf("Moving %10u population from %s to %s.\n", popMigration, getName().c_str(), target->getName().c_str());
 }
 
+float SolarObject::getStarDistance() const
+{
+	float d = 0.0f;
+	for(auto o = this; o; o = o->mCenter)
+		d += o->mOrbit;
+	return d;
+}
+
 Market* SolarObject::getMarket()
 {
 	assert(hasMarket());
-	return mSettlement->getMarket();
+	return getSettlement()->getMarket();
 }
 
 const Market* SolarObject::getMarket() const
 {
 	assert(hasMarket());
-	return mSettlement->getMarket();
+	return getSettlement()->getMarket();
 }
 
 float SolarObject::getSettlementHappiness() const
 {
-	assert(mSettlement);
-	return mSettlement->getHappiness();
+	assert(hasSettlement());
+	return getSettlement()->getHappiness();
 }
 
-const Trader& SolarObject::getTrader() const
+const MarketTrader& SolarObject::getTrader() const
 {
 	assert(hasMarket());
-	return mSettlement->getMarket()->getTrader();
+	return getSettlement()->getMarket()->getTrader();
 }
 
-
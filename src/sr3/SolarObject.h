@@ -8,21 +8,20 @@
 #include "common/Entity.h"
 
 #include "Constants.h"
+#include "Settlement.h"
 
-class Settlement;
 class Market;
-class Trader;
 
 class SolarObject : public Common::Entity {
 	public:
 		SolarObject(const std::string& name, float size, float mass);
-		~SolarObject();
 		SolarObject(const SolarObject&) = delete;
 		SolarObject(const SolarObject&&) = delete;
 		SolarObject& operator=(const SolarObject&) & = delete;
 		SolarObject& operator=(SolarObject&&) & = delete;
-		SolarObject(const SolarObject* center, const std::string& name, SOType type,
-				float size, float mass, float orbit, float speed, unsigned int marketlevel);
+		// the settlement, if any, is created in the arena of the system
+		SolarObject(SettlementArena* settlements, const SolarObject* center, const std::string& name,
+				SOType type, float size, float mass, float orbit, float speed, unsigned int marketlevel);
 		bool canBeColonised() const;
 		float getSize() const { return mSize; }
 		float getArea() const { return mSize * mSize; }
@@ -30,18 +29,24 @@ class SolarObject : public Common::Entity {
 		float getMass() const { return mMass; }
 		virtual void update(float time) override;
 		SOType getType() const { return mObjectType; }
-		Settlement* getSettlement() { return mSettlement; }
-		const Settlement* getSettlement() const { return mSettlement; }
+		Settlement* getSettlement() { return hasSettlement() ? &mSettlements->get(mSettlement) : nullptr; }
+		const Settlement* getSettlement() const { return hasSettlement() ? &mSettlements->get(mSettlement) : nullptr; }
 		const std::string& getName() const { return mName; }
-		bool hasMarket() const { return mSettlement != nullptr; }
-		bool hasSettlement() const { return mSettlement != nullptr; }
+		bool hasMarket() const { return hasSettlement(); }
+		bool hasSettlement() const { return mSettlement != SettlementArena::None; }
 		float getSettlementHappiness() const;
 		Market* getMarket();
 		const Market* getMarket() const;
-		const Trader& getTrader() const;
-		bool updateSettlement();
+		const MarketTrader& getTrader() const;
 		Settlement* getOrCreateSettlement();
 		void colonise(SolarObject* target);
+		// the radii of the orbits out to the star added up; unlike the
+		// position it does not change with time
+		float getStarDistance() const;
+
+		// index in the settlement arena, used when paging the arena
+		unsigned int getSettlementIndex() const { return mSettlement; }
+		void setSettlementIndex(unsigned int i) { mSettlement = i; }
 
 	private:
 		std::string mName;
@@ -52,7 +57,8 @@ class SolarObject : public Common::Entity {
 		float mSpeed = 0.0f;
 		const SolarObject* mCenter = nullptr;
 		SOType mObjectType = SOType::GasGiant;
-		Settlement* mSettlement = nullptr;
+		SettlementArena* mSettlements = nullptr;
+		unsigned int mSettlement = SettlementArena::None;
 };
 
 
@@ -0,0 +1,775 @@
+#include <cassert>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <new>
+#include <random>
+
+#include "SolarSystem.h"
+#include "SolarObject.h"
+#include "Settlement.h"
+#include "Product.h"
+#include "Econ.h"
+#include "StateBuffer.h"
+#include "EconSnapshot.h"
+
+TradeRoute::TradeRoute(SolarObject* from, SolarObject* to, const std::string& product)
+	: mFrom(from),
+	mTo(to),
+	mProduct(product),
+	mProductId(ProductCatalog::getInstance()->getId(product))
+{
+}
+
+void TradeRoute::assign(SolarObject* from, SolarObject* to, const std::string& product)
+{
+	mFrom = from;
+	mTo = to;
+	mProduct.assign(product);
+	mProductId = ProductCatalog::getInstance()->getId(product);
+	mMargin = 0.0f;
+	mFromEpoch = 0;
+	mToEpoch = 0;
+}
+
+EconTimeline::EconTimeline()
+{
+	reset();
+}
+
+void EconTimeline::reset()
+{
+	Origin = std::chrono::steady_clock::now();
+	for(unsigned int i = 0; i < NumEconStages; i++) {
+		Start[i] = -1.0;
+		End[i] = -1.0;
+	}
+}
+
+void EconTimeline::mark(EconStage s, std::chrono::steady_clock::time_point start,
+		std::chrono::steady_clock::time_point end)
+{
+	auto i = (unsigned int)s;
+	if(Start[i] < 0.0)
+		Start[i] = std::chrono::duration<double, std::milli>(start - Origin).count();
+	End[i] = std::chrono::duration<double, std::milli>(end - Origin).count();
+}
+
+const char* EconTimeline::getName(EconStage s)
+{
+	static const char* names[NumEconStages] = { "imports", "prices", "settlements",
+		"colonisation", "network", "fleet", "exports" };
+	return names[(unsigned int)s];
+}
+
+float TradeRoute::getMargin() const
+{
+	auto m1 = mFrom->getMarket();
+	auto m2 = mTo->getMarket();
+	if(mFromEpoch != m1->getPriceEpoch() || mToEpoch != m2->getPriceEpoch()) {
+		mMargin = m2->getPrice(mProductId) - m1->getPrice(mProductId);
+		mFromEpoch = m1->getPriceEpoch();
+		mToEpoch = m2->getPriceEpoch();
+	}
+	return mMargin;
+}
+
+
+void TradeNetwork::addTradeRoute(SolarObject* from, SolarObject* to, const std::string& product)
+{
+	auto& routes = mTradeRoutes[from];
+	if(from != mReuseFrom) {
+		mReuseFrom = from;
+		mReusePos = 0;
+	}
+	auto it = mOldRoutes.find(from);
+	if(it != mOldRoutes.end()) {
+		const auto& old = it->second;
+		for(auto i = mReusePos; i < old.size(); i++) {
+			if(old[i]->getTo() == to && old[i]->getProduct() == product) {
+				routes.push_back(old[i]);
+				mReusePos = i + 1;
+				return;
+			}
+		}
+		// Routes reused above or held by a snapshot or a ship are shared.
+		// Only this network can hand out the others, so they are safe to
+		// change even while other threads drop their references.
+		for(const auto& tr : old) {
+			if(tr.use_count() == 1) {
+				tr->assign(from, to, product);
+				routes.push_back(tr);
+				return;
+			}
+		}
+	}
+	if(!mSpareRoutes.empty()) {
+		mSpareRoutes.back()->assign(from, to, product);
+		routes.push_back(std::move(mSpareRoutes.back()));
+		mSpareRoutes.pop_back();
+		return;
+	}
+	routes.push_back(boost::shared_ptr<TradeRoute>(new TradeRoute(from, to, product)));
+}
+
+void TradeNetwork::clearTradeRoutesFrom(const SolarObject* from)
+{
+	// the vectors are kept, and the routes of two builds ago that nothing
+	// else holds are kept as spares
+	auto& routes = mTradeRoutes[from];
+	mOldRoutes[from].swap(routes);
+	for(auto& tr : routes) {
+		if(tr.use_count() == 1)
+			mSpareRoutes.push_back(std::move(tr));
+	}
+	routes.clear();
+	mReuseFrom = from;
+	mReusePos = 0;
+}
+
+void TradeNetwork::removeTradeRoutesWith(const SolarObject* obj)
+{
+	for(auto m : { &mTradeRoutes, &mOldRoutes }) {
+		m->erase(obj);
+		for(auto& it : *m) {
+			auto& routes = it.second;
+			routes.erase(std::remove_if(routes.begin(), routes.end(),
+						[obj] (const boost::shared_ptr<TradeRoute>& tr) { return tr->getTo() == obj; }),
+					routes.end());
+		}
+	}
+	if(mReuseFrom == obj)
+		mReuseFrom = nullptr;
+	mReusePos = 0;
+}
+
+void TradeNetwork::copyTradeRoutes(const TradeNetwork& n)
+{
+	// walks both maps in order and assigns the route lists in place, so
+	// the nodes and vectors of markets in both are reused
+	auto less = mTradeRoutes.key_comp();
+	auto it = mTradeRoutes.begin();
+	for(const auto& routes : n.mTradeRoutes) {
+		while(it != mTradeRoutes.end() && less(it->first, routes.first))
+			it = mTradeRoutes.erase(it);
+		if(it == mTradeRoutes.end() || less(routes.first, it->first))
+			it = mTradeRoutes.emplace_hint(it, routes.first, routes.second);
+		else
+			it->second = routes.second;
+		++it;
+	}
+	mTradeRoutes.erase(it, mTradeRoutes.end());
+}
+
+unsigned int TradeNetwork::getNumSources() const
+{
+	unsigned int num = 0;
+	for(const auto& it : mTradeRoutes) {
+		if(!it.second.empty())
+			num++;
+	}
+	return num;
+}
+
+std::vector<boost::shared_ptr<TradeRoute>>& TradeNetwork::getTradeRoutesFrom(const SolarObject* from)
+{
+	static std::vector<boost::shared_ptr<TradeRoute>> empty;
+	auto it = mTradeRoutes.find(from);
+	return it == mTradeRoutes.end() ? empty : it->second;
+}
+
+const std::map<const SolarObject*, std::vector<boost::shared_ptr<TradeRoute>>>& TradeNetwork::getTradeRoutes() const
+{
+	return mTradeRoutes;
+}
+
+const std::vector<boost::shared_ptr<TradeRoute>>& TradeNetwork::getTradeRoutesFrom(const SolarObject* from) const
+{
+	static std::vector<boost::shared_ptr<TradeRoute>> empty;
+	auto it = mTradeRoutes.find(from);
+	return it == mTradeRoutes.end() ? empty : it->second;
+}
+
+SolarSystem::SolarSystem()
+	: mFleet(Money(), 0)
+{
+	srand(21);
+	auto star = new SolarObject("Sol", 1.0f, 1.0f);
+	mObjects.push_back(star);
+	mObjects.push_back(new SolarObject(&mSettlements, star, "Mercury", SOType::RockyNoAtmosphere, 0.5f, 0.5f, 0.4f, 3.0f, 0));
+	mObjects.push_back(new SolarObject(&mSettlements, star, "Venus", SOType::RockyCarbonDioxide, 0.9f, 0.9f, 0.7f, 2.0f, 1));
+	auto p1 = new SolarObject(&mSettlements, star, "Earth", SOType::RockyOxygen, 1.0f, 1.0f, 1.0f, 1.0f, 8);
+	auto m1 = new SolarObject(&mSettlements, p1, "Moon", SOType::RockyNoAtmosphere, 0.4f, 0.2f, 0.1f, 3.0f, 3);
+	mObjects.push_back(p1);
+	mObjects.push_back(m1);
+	mObjects.push_back(new SolarObject(&mSettlements, star, "Mars", SOType::RockyCarbonDioxide, 0.7f, 0.7f, 2.0f, 0.5f, 6));
+	auto p2 = new SolarObject(&mSettlements, star, "Jupiter", SOType::GasGiant, 15.0f, 15.0f, 4.0f, 0.25f, 0);
+	auto m2 = new SolarObject(&mSettlements, p2, "Io", SOType::RockyNoAtmosphere, 0.2f, 0.2f, 0.3f, 3.0f, 1);
+	auto m3 = new SolarObject(&mSettlements, p2, "Europa", SOType::RockyNoAtmosphere, 0.2f, 0.2f, 0.4f, 3.0f, 1);
+	auto m4 = new SolarObject(&mSettlements, p2, "Ganymede", SOType::RockyNoAtmosphere, 0.2f, 0.2f, 0.5f, 3.0f, 0);
+	auto m5 = new SolarObject(&mSettlements, p2, "Callisto", SOType::RockyNoAtmosphere, 0.2f, 0.2f, 0.6f, 3.0f, 0);
+	mObjects.push_back(p2);
+	mObjects.push_back(m2);
+	mObjects.push_back(m3);
+	mObjects.push_back(m4);
+	mObjects.push_back(m5);
+	auto p3 = new SolarObject(&mSettlements, star, "Saturn", SOType::GasGiant, 10.0f, 10.0f, 8.0f, 0.25f, 0);
+	auto m6 = new SolarObject(&mSettlements, p3, "Dione", SOType::RockyNoAtmosphere, 0.2f, 0.2f, 0.3f, 2.0f, 0);
+	auto m7 = new SolarObject(&mSettlements, p3, "Rhea", SOType::RockyNoAtmosphere, 0.2f, 0.2f, 0.4f, 2.0f, 0);
+	auto m8 = new SolarObject(&mSettlements, p3, "Titan", SOType::RockyNoAtmosphere, 0.2f, 0.2f, 0.5f, 2.0f, 1);
+	auto m9 = new SolarObject(&mSettlements, p3, "Iapetus", SOType::RockyNoAtmosphere, 0.2f, 0.2f, 0.6f, 2.0f, 0);
+	mObjects.push_back(p3);
+	mObjects.push_back(m6);
+	mObjects.push_back(m7);
+	mObjects.push_back(m8);
+	mObjects.push_back(m9);
+
+	updateTradeNetwork();
+}
+
+namespace {
+	class SystemRandom {
+		public:
+			SystemRandom(unsigned int seed) : mGen(seed) { }
+			float uniform() { return (mGen() >> 8) * (1.0f / 16777216.0f); }
+			float range(float a, float b) { return a + uniform() * (b - a); }
+			unsigned int below(unsigned int n) { return mGen() % n; }
+			SOType pickType(const float* weights);
+
+		private:
+			std::mt19937 mGen;
+	};
+
+	SOType SystemRandom::pickType(const float* weights)
+	{
+		float total = 0.0f;
+		for(unsigned int i = 0; i < NumSOTypes; i++)
+			total += weights[i];
+		assert(total > 0.0f);
+		float r = uniform() * total;
+		for(unsigned int i = 0; i < NumSOTypes; i++) {
+			if(r < weights[i])
+				return SOType(i);
+			r -= weights[i];
+		}
+		return SOType::RockyNoAtmosphere;
+	}
+
+	unsigned int pickMarketLevel(SystemRandom& rng, const SystemParameters& params,
+			SOType type, float size, float mass)
+	{
+		// same rule as SolarObject::canBeColonised()
+		if(mass >= 10.0f || type == SOType::Star || type == SOType::GasGiant)
+			return 0;
+		if(rng.uniform() >= params.SettlementProbability)
+			return 0;
+
+		auto maxPop = Constants::MaxPopulation * size * size;
+		unsigned int level = params.MinMarketLevel +
+			rng.below(params.MaxMarketLevel - params.MinMarketLevel + 1);
+		while(level > 0 && pow(5, level) + 200 > maxPop)
+			level--;
+		return level;
+	}
+}
+
+SolarSystem::SolarSystem(const SystemParameters& params)
+	: mFleet(Money(), 0)
+{
+	assert(params.MinMarketLevel <= params.MaxMarketLevel);
+	assert(params.MaxMarketLevel <= 8);
+	assert(params.NumPlanets > 0 || params.NumMoons == 0);
+
+	srand(params.Seed);
+	SystemRandom rng(params.Seed);
+	unsigned int total = 1 + params.NumPlanets + params.NumMoons + params.NumAsteroids;
+	mObjectBlock = static_cast<SolarObject*>(::operator new(sizeof(SolarObject) * total));
+	mObjects.reserve(total);
+	char buf[16];
+
+	auto star = new(&mObjectBlock[mNumBlockObjects++]) SolarObject("Star", 1.0f, 1.0f);
+	mObjects.push_back(star);
+
+	float orbit = 0.4f;
+	for(unsigned int i = 0; i < params.NumPlanets; i++) {
+		auto type = rng.pickType(params.PlanetTypes);
+		auto size = type == SOType::GasGiant ? rng.range(5.0f, 15.0f) : rng.range(0.3f, 1.5f);
+		auto mass = size;
+		auto level = pickMarketLevel(rng, params, type, size, mass);
+		snprintf(buf, sizeof(buf), "P%u", i + 1);
+		mObjects.push_back(new(&mObjectBlock[mNumBlockObjects++]) SolarObject(&mSettlements, star, buf, type,
+					size, mass, orbit, 1.0f / orbit, level));
+		orbit += rng.range(0.3f, 0.7f);
+	}
+
+	for(unsigned int i = 0; i < params.NumMoons; i++) {
+		auto planet = mObjects[1 + rng.below(params.NumPlanets)];
+		auto type = rng.pickType(params.MoonTypes);
+		auto size = rng.range(0.1f, 0.5f);
+		auto mass = size * 0.5f;
+		auto level = pickMarketLevel(rng, params, type, size, mass);
+		snprintf(buf, sizeof(buf), "M%u", i + 1);
+		mObjects.push_back(new(&mObjectBlock[mNumBlockObjects++]) SolarObject(&mSettlements, planet, buf, type,
+					size, mass, rng.range(0.1f, 0.6f), rng.range(2.0f, 3.0f), level));
+	}
+
+	// asteroid belt around the middle of the planetary orbits
+	float beltCenter = orbit * 0.5f;
+	for(unsigned int i = 0; i < params.NumAsteroids; i++) {
+		auto type = rng.pickType(params.AsteroidTypes);
+		auto size = rng.range(0.01f, 0.1f);
+		auto mass = size * 0.1f;
+		auto level = pickMarketLevel(rng, params, type, size, mass);
+		auto astOrbit = beltCenter + rng.range(-0.3f, 0.3f);
+		snprintf(buf, sizeof(buf), "A%u", i + 1);
+		mObjects.push_back(new(&mObjectBlock[mNumBlockObjects++]) SolarObject(&mSettlements, star, buf, type,
+					size, mass, astOrbit, 1.0f / astOrbit, level));
+	}
+	assert(mNumBlockObjects == total);
+	recordTradeInputs();
+}
+
+void SolarSystem::updateTradeNetwork()
+{
+	recordTradeInputs();
+	stepTradeNetwork(std::chrono::steady_clock::time_point::max());
+}
+
+void SolarSystem::recordTradeInputs()
+{
+	auto num = ProductCatalog::getInstance()->getNumProducts();
+	mRouteMarkets.clear();
+	mRouteMoney.clear();
+	mRoutePrices.clear();
+	mRouteStocked.clear();
+	for(SolarObject* o : mObjects) {
+		if(!o->hasMarket())
+			continue;
+
+		const auto& m = o->getMarket();
+		mRouteMarkets.push_back(o);
+		mRouteMoney.push_back(m->getMoney());
+		for(ProductId id = 0; id < num; id++) {
+			mRoutePrices.push_back(m->getPrice(id));
+			mRouteStocked.push_back(m->items(id) > 0);
+		}
+	}
+	mRoutePos = 0;
+}
+
+bool SolarSystem::stepTradeNetwork(std::chrono::steady_clock::time_point deadline)
+{
+	if(mRoutePos == mRouteMarkets.size())
+		return true;
+
+	auto start = std::chrono::steady_clock::now();
+	while(mRoutePos < mRouteMarkets.size()) {
+		updateTradeRoutesFrom(mRoutePos++);
+		if(mRoutePos < mRouteMarkets.size() && std::chrono::steady_clock::now() >= deadline)
+			break;
+	}
+	mTimeline.mark(EconStage::TradeNetwork, start, std::chrono::steady_clock::now());
+	return mRoutePos == mRouteMarkets.size();
+}
+
+void SolarSystem::updateTradeRoutesFrom(unsigned int source)
+{
+	auto o = mRouteMarkets[source];
+	mTradeNetwork.clearTradeRoutesFrom(o);
+	auto catalog = ProductCatalog::getInstance();
+	auto num = catalog->getNumProducts();
+
+	// collect the goods in stock once instead of checking every
+	// product for every pair of markets
+	mOffers.clear();
+	for(ProductId id = 0; id < num; id++) {
+		if(mRouteStocked[source * num + id])
+			mOffers.push_back({id, 1.5f * mRoutePrices[source * num + id]});
+	}
+	if(mOffers.empty())
+		return;
+
+	for(unsigned int dest = 0; dest < mRouteMarkets.size(); dest++) {
+		if(dest == source)
+			continue;
+
+		auto money = mRouteMoney[dest];
+		for(const auto& offer : mOffers) {
+			auto price = mRoutePrices[dest * num + offer.first];
+			if(price > offer.second && money.toCredits() > price) {
+				mTradeNetwork.addTradeRoute(o, mRouteMarkets[dest], catalog->getName(offer.first));
+			}
+		}
+	}
+}
+
+void SolarSystem::updateSettlements()
+{
+	mTimeline.reset();
+	beginTick();
+	stepTick(std::chrono::steady_clock::time_point::max());
+	endTick();
+	stepTradeNetwork(std::chrono::steady_clock::time_point::max());
+}
+
+void SolarSystem::beginTick()
+{
+	assert(!mTicking);
+	auto start = std::chrono::steady_clock::now();
+	// also renews the due list, so settlements founded during the tick
+	// are first updated on the next one
+	mSettlements.updatePrices();
+	mTickSettlementPos = 0;
+	mColonising.clear();
+	mAbandoning.clear();
+	mTicking = true;
+	mTimeline.mark(EconStage::Prices, start, std::chrono::steady_clock::now());
+}
+
+bool SolarSystem::stepTick(std::chrono::steady_clock::time_point deadline)
+{
+	assert(mTicking);
+	auto start = std::chrono::steady_clock::now();
+	const auto& due = mSettlements.getDue();
+	while(mTickSettlementPos < due.size()) {
+		auto i = due[mTickSettlementPos++];
+		auto& s = mSettlements.get(i);
+		bool colonising = s.update(mSettlements.getElapsed(i));
+		if(colonising)
+			mColonising.push_back(i);
+		mSettlements.finishUpdate(i, colonising);
+		if(s.isAbandoned())
+			mAbandoning.push_back(i);
+		if(mTickSettlementPos < due.size() && std::chrono::steady_clock::now() >= deadline) {
+			mTimeline.mark(EconStage::Settlements, start, std::chrono::steady_clock::now());
+			return false;
+		}
+	}
+	auto colonisation = std::chrono::steady_clock::now();
+	mTimeline.mark(EconStage::Settlements, start, colonisation);
+
+	// in arena order once all settlements have been updated; new
+	// producers may have spent the money since the settlement's update
+	for(auto i : mColonising) {
+		if(mSettlements.get(i).canColonise())
+			foundNewSettlement(mSettlements.getObject(i));
+	}
+	mTimeline.mark(EconStage::Colonisation, colonisation, std::chrono::steady_clock::now());
+	mTicking = false;
+	return true;
+}
+
+void SolarSystem::endTick()
+{
+	assert(!mTicking);
+	// colonisation may have brought people since
+	for(auto i : mAbandoning) {
+		if(mSettlements.get(i).isAbandoned())
+			abandonSettlement(i);
+	}
+	mAbandoning.clear();
+	recordTradeInputs();
+}
+
+void SolarSystem::updateFleetTrade()
+{
+	if(!mFleetSize)
+		return;
+
+	auto& routes = mFleetRoutes;
+	routes.clear();
+	for(const auto& it : mTradeNetwork.getTradeRoutes()) {
+		for(const auto& tr : it.second)
+			routes.push_back(tr.get());
+	}
+	if(routes.empty())
+		return;
+
+	// traders pick from the better half of the routes
+	std::sort(routes.begin(), routes.end(), [] (const TradeRoute* r1, const TradeRoute* r2) -> bool {
+			return r1->getMargin() > r2->getMargin(); } );
+	auto numRoutes = std::max<unsigned int>(1, routes.size() / 2);
+
+	unsigned int trips = mFleetSize * Constants::DormantTripsPerTick + 0.5f;
+	for(unsigned int i = 0; i < trips; i++) {
+		auto tr = routes[i % numRoutes];
+		auto from = tr->getFrom();
+		auto to = tr->getTo();
+		from->getMarket()->buy(tr->getProduct(), Constants::SpaceShipCargoSpace, mFleet,
+				Econ::Entity::Trader, from);
+
+		// always sell everything on arrival if possible
+		mFleet.forEachItem([&] (ProductId id, unsigned int num) {
+				to->getMarket()->sell(id, num, mFleet, Econ::Entity::Trader, to); });
+	}
+}
+
+void SolarSystem::getPriceRanges(std::map<std::string, PriceRange>& ranges) const
+{
+	// reset in place; the set of products does not change between ticks
+	for(auto& it : ranges)
+		it.second = PriceRange();
+	for(const auto& o : mObjects) {
+		if(!o->hasMarket())
+			continue;
+
+		const auto m = o->getMarket();
+		auto catalog = ProductCatalog::getInstance();
+		for(ProductId prod = 0; prod < catalog->getNumProducts(); prod++) {
+			auto price = m->getPrice(prod);
+			auto& range = ranges[catalog->getName(prod)];
+			if(m->items(prod) && price < range.Lowest)
+				range.Lowest = price;
+			if(m->getMoney().toCredits() > price && price > range.Highest)
+				range.Highest = price;
+		}
+	}
+}
+
+unsigned int SolarSystem::exportGoods(const std::string& product, unsigned int num)
+{
+	SolarObject* cheapest = nullptr;
+	for(auto o : mObjects) {
+		if(!o->hasMarket() || !o->getMarket()->items(product))
+			continue;
+		if(!cheapest || o->getMarket()->getPrice(product) < cheapest->getMarket()->getPrice(product))
+			cheapest = o;
+	}
+	if(!cheapest)
+		return 0;
+
+	auto bought = cheapest->getMarket()->buy(product, num, mFleet, Econ::Entity::Trader, cheapest);
+	mFleet.removeFromStorage(product, bought);
+	return bought;
+}
+
+void SolarSystem::importGoods(const std::string& product, unsigned int num)
+{
+	SolarObject* best = nullptr;
+	for(auto o : mObjects) {
+		if(!o->hasMarket())
+			continue;
+		if(!best || o->getMarket()->getPrice(product) > best->getMarket()->getPrice(product))
+			best = o;
+	}
+
+	// anything the best market cannot take stays with the fleet
+	mFleet.addToStorage(product, num);
+	if(best)
+		best->getMarket()->sell(product, num, mFleet, Econ::Entity::Trader, best);
+}
+
+void SolarSystem::saveState(StateWriter& w) const
+{
+	assert(mResident);
+	// Settlements are saved in arena order to keep the update order,
+	// leaving out the free slots. Indices are saved as the rank among
+	// the live settlements.
+	std::vector<unsigned int> rank(mSettlements.size(), SettlementArena::None);
+	unsigned int num = 0;
+	for(unsigned int i = 0; i < mSettlements.size(); i++) {
+		if(mSettlements.isLive(i))
+			rank[i] = num++;
+	}
+	w.write(num);
+	for(auto o : mObjects) {
+		auto i = o->getSettlementIndex();
+		w.write(i == SettlementArena::None ? i : rank[i]);
+	}
+	for(unsigned int i = 0; i < mSettlements.size(); i++) {
+		if(mSettlements.isLive(i))
+			mSettlements.save(i, w);
+	}
+	w.write(mFleetSize);
+	mFleet.save(w);
+}
+
+void SolarSystem::evictState()
+{
+	assert(mResident);
+	assert(!mTicking);
+	for(auto o : mObjects)
+		o->setSettlementIndex(SettlementArena::None);
+	mSettlements.clear();
+	// drop the reusable routes and buffers as well
+	mTradeNetwork = TradeNetwork();
+	mOffers = std::vector<std::pair<ProductId, float>>();
+	mFleetRoutes = std::vector<TradeRoute*>();
+	mColonising = std::vector<unsigned int>();
+	mAbandoning = std::vector<unsigned int>();
+	mRouteMarkets = std::vector<SolarObject*>();
+	mRouteMoney = std::vector<Money>();
+	mRoutePrices = std::vector<float>();
+	mRouteStocked = std::vector<unsigned char>();
+	mRoutePos = 0;
+	mFleet.clearAll();
+	// the snapshots are taken afresh once the system is observed again
+	delete mSnapshots[0];
+	delete mSnapshots[1];
+	mSnapshots[0] = mSnapshots[1] = nullptr;
+	mFrontSnapshot.store(-1);
+	mResident = false;
+}
+
+void SolarSystem::loadState(StateReader& r)
+{
+	assert(!mResident);
+	unsigned int num;
+	r.read(num);
+	std::vector<SolarObject*> objects(num, nullptr);
+	for(auto o : mObjects) {
+		unsigned int i;
+		r.read(i);
+		if(i != SettlementArena::None)
+			objects[i] = o;
+	}
+	for(unsigned int i = 0; i < num; i++) {
+		assert(objects[i]);
+		auto j = mSettlements.load(objects[i], r);
+		objects[i]->setSettlementIndex(j);
+	}
+	r.read(mFleetSize);
+	mFleet.load(r);
+	assert(r.atEnd());
+	mResident = true;
+	updateTradeNetwork();
+}
+
+void SolarSystem::abandonSettlement(unsigned int i)
+{
+	// The last people move to the nearest settlement with room for them
+	// and take all the money of the settlement along. Without one the
+	// money goes to the fleet. Goods left in the market are lost.
+	auto obj = mSettlements.getObject(i);
+	auto& s = mSettlements.get(i);
+	auto pop = s.getPopulation();
+	SolarObject* target = nullptr;
+	float nearest = 0.0f;
+	for(auto o : mObjects) {
+		if(o == obj || !o->hasSettlement() || o->getSettlement()->isAbandoned())
+			continue;
+		if(o->getMaxPopulation() < o->getSettlement()->getPopulation() + pop)
+			continue;
+		auto d = std::fabs(o->getStarDistance() - obj->getStarDistance());
+		if(!target || d < nearest) {
+			target = o;
+			nearest = d;
+		}
+	}
+
+	auto money = s.takeAllMoney();
+	if(target) {
+		auto people = target->getSettlement()->getPopulationObj();
+		people->addPop(pop);
+		if(money > Money())
+			people->addMoney(money);
+		mSettlements.wake(target->getSettlementIndex());
+	} else {
+		if(money > Money())
+			mFleet.addMoney(money);
+	}
+	mTradeNetwork.removeTradeRoutesWith(obj);
+	obj->setSettlementIndex(SettlementArena::None);
+	mSettlements.erase(i);
+}
+
+void SolarSystem::foundNewSettlement(SolarObject* from)
+{
+	SolarObject* target = nullptr;
+	auto maxHappiness = 0.0f;
+
+	auto popMigrating = from->getSettlement()->getPopulation() * Constants::PercentagePopulationColonised;
+
+	// pick object with highest happiness if any
+	for(auto& obj : mObjects) {
+		if(obj == from)
+			continue;
+
+		if(!obj->hasSettlement())
+			continue;
+
+		// ensure the target doesn't receive more immigrants than it can handle
+		auto migrateSpace = obj->getMaxPopulation() - obj->getSettlement()->getPopulation();
+		if(migrateSpace < popMigrating * 2)
+			continue;
+
+		auto hap = obj->getSettlementHappiness();
+		if(hap > 0.4f && hap > maxHappiness) {
+			target = obj;
+			maxHappiness = hap;
+		}
+	}
+
+	// if none found colonise a new object
+	if(!target) {
+		for(auto& obj : mObjects) {
+			if(obj == from)
+				continue;
+
+			if(!obj->canBeColonised())
+				continue;
+
+			// same limit as for existing settlements
+			if(obj->getMaxPopulation() < popMigrating * 2)
+				continue;
+
+			if(!obj->hasSettlement()) {
+				target = obj;
+				break;
+			}
+		}
+	}
+
+	if(target) {
+		from->colonise(target);
+	}
+}
+
+SolarSystem::~SolarSystem()
+{
+	delete mSnapshots[0];
+	delete mSnapshots[1];
+	if(mObjectBlock) {
+		for(unsigned int i = mNumBlockObjects; i-- > 0; )
+			mObjectBlock[i].~SolarObject();
+		::operator delete(mObjectBlock);
+	} else {
+		for(auto& o : mObjects)
+			delete o;
+	}
+}
+
+const std::vector<SolarObject*>& SolarSystem::getObjects() const
+{
+	return mObjects;
+}
+
+const EconSnapshot* SolarSystem::getSnapshot() const
+{
+	auto front = mFrontSnapshot.load(std::memory_order_acquire);
+	return front < 0 ? nullptr : mSnapshots[front];
+}
+
+void SolarSystem::takeSnapshot()
+{
+	assert(mResident);
+	auto back = mFrontSnapshot.load(std::memory_order_relaxed) == 0 ? 1 : 0;
+	if(!mSnapshots[back])
+		mSnapshots[back] = new EconSnapshot();
+	mSnapshots[back]->take(mObjects, mTradeNetwork);
+}
+
+void SolarSystem::publishSnapshot()
+{
+	auto back = mFrontSnapshot.load(std::memory_order_relaxed) == 0 ? 1 : 0;
+	assert(mSnapshots[back]);
+	mFrontSnapshot.store(back, std::memory_order_release);
+}
+
+void SolarSystem::update(float time)
+{
+	for(auto& o : mObjects) {
+		o->update(time);
+	}
+}
+
@@ -0,0 +1,272 @@
+#ifndef SR3_SOLARSYSTEM_H
+#define SR3_SOLARSYSTEM_H
+
+#include <string>
+#include <map>
+#include <vector>
+#include <cfloat>
+#include <chrono>
+#include <atomic>
+
+#include <boost/shared_ptr.hpp>
+
+#include "Constants.h"
+#include "Settlement.h"
+
+class SolarObject;
+class StateWriter;
+class StateReader;
+class EconSnapshot;
+
+class TradeRoute {
+	public:
+		TradeRoute(SolarObject* from, SolarObject* to, const std::string& product);
+		SolarObject* getFrom() { return mFrom; }
+		SolarObject* getTo() { return mTo; }
+		const SolarObject* getFrom() const { return mFrom; }
+		const SolarObject* getTo() const { return mTo; }
+		const std::string& getProduct() const { return mProduct; }
+		ProductId getProductId() const { return mProductId; }
+		// price at the destination minus price at the source, computed
+		// once per price epoch of the two markets
+		float getMargin() const;
+
+	private:
+		friend class TradeNetwork;
+		// turns the route into another one, keeping its storage
+		void assign(SolarObject* from, SolarObject* to, const std::string& product);
+
+		SolarObject* mFrom;
+		SolarObject* mTo;
+		std::string mProduct;
+		ProductId mProductId;
+		mutable float mMargin = 0.0f;
+		mutable uint64_t mFromEpoch = 0;
+		mutable uint64_t mToEpoch = 0;
+};
+
+class TradeNetwork {
+	public:
+		void addTradeRoute(SolarObject* from, SolarObject* to, const std::string& product);
+		// starts a new build of the routes from one market; the routes of
+		// the other markets are kept
+		void clearTradeRoutesFrom(const SolarObject* from);
+		// drops all routes from or to a market that no longer exists
+		void removeTradeRoutesWith(const SolarObject* obj);
+		// copies the current routes of another network
+		void copyTradeRoutes(const TradeNetwork& n);
+		std::vector<boost::shared_ptr<TradeRoute>>& getTradeRoutesFrom(const SolarObject* from);
+		const std::vector<boost::shared_ptr<TradeRoute>>& getTradeRoutesFrom(const SolarObject* from) const;
+		// may contain markets without routes
+		const std::map<const SolarObject*, std::vector<boost::shared_ptr<TradeRoute>>>& getTradeRoutes() const;
+		// number of markets with at least one route
+		unsigned int getNumSources() const;
+
+	private:
+		std::map<const SolarObject*, std::vector<boost::shared_ptr<TradeRoute>>> mTradeRoutes;
+
+		// The routes of the previous build. A rebuild adds the routes of each
+		// market in the same order, so unchanged routes are found by scanning
+		// forward from the last reused one and reused without allocating.
+		// A changed route takes over an old one that nothing else holds, or
+		// a spare one released by an earlier build.
+		std::map<const SolarObject*, std::vector<boost::shared_ptr<TradeRoute>>> mOldRoutes;
+		std::vector<boost::shared_ptr<TradeRoute>> mSpareRoutes;
+		const SolarObject* mReuseFrom = nullptr;
+		size_t mReusePos = 0;
+};
+
+// Stages of the econ tick of a system and the state they read and write.
+// Consumption, labour and production stay one stage, as each settlement
+// trades with its market in a single pass.
+//   Imports       writes markets and the fleet
+//   Prices        writes the prices of all markets
+//   Settlements   each settlement writes only itself and its market
+//   Colonisation  moves people and money between settlements and may
+//                 found new ones
+//   TradeNetwork  reads the market inputs recorded at the end of the
+//                 previous tick and writes the routes, so it can run on
+//                 another core while the three stages above run
+//   FleetTrade    reads the routes, writes markets and the fleet
+//   Exports       writes the fleet
+enum class EconStage {
+	Imports,
+	Prices,
+	Settlements,
+	Colonisation,
+	TradeNetwork,
+	FleetTrade,
+	Exports
+};
+
+const unsigned int NumEconStages = (unsigned int)EconStage::Exports + 1;
+
+// When the stages of the last econ tick of a system ran, in milliseconds
+// from the start of the tick. A stage run in several steps spans from
+// the start of its first step to the end of its last one; a stage that
+// did not run has a negative start.
+struct EconTimeline {
+	std::chrono::steady_clock::time_point Origin;
+	double Start[NumEconStages];
+	double End[NumEconStages];
+
+	EconTimeline();
+	void reset();
+	void mark(EconStage s, std::chrono::steady_clock::time_point start,
+			std::chrono::steady_clock::time_point end);
+	static const char* getName(EconStage s);
+};
+
+// Lowest price of a market that has the product in stock and highest
+// price of a market that can pay for it.
+struct PriceRange {
+	float Lowest = FLT_MAX;
+	float Highest = 0.0f;
+};
+
+// Parameters for a procedurally generated solar system.
+struct SystemParameters {
+	unsigned int Seed = 21;
+	unsigned int NumPlanets = 8;
+	unsigned int NumMoons = 16;
+	unsigned int NumAsteroids = 0;
+
+	// relative weights of each SOType, indexed by SOType
+	float PlanetTypes[NumSOTypes]   = { 0.0f, 0.3f, 0.2f, 0.1f, 0.1f, 0.2f, 0.1f };
+	float MoonTypes[NumSOTypes]     = { 0.0f, 0.0f, 0.7f, 0.0f, 0.1f, 0.1f, 0.1f };
+	float AsteroidTypes[NumSOTypes] = { 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+
+	// chance of a colonisable body having a settlement, and the range
+	// of the initial market level. The level is capped so that the
+	// initial population fits on the body.
+	float SettlementProbability = 0.2f;
+	unsigned int MinMarketLevel = 1;
+	unsigned int MaxMarketLevel = 6;
+};
+
+class SolarSystem {
+	public:
+		SolarSystem();
+		// Generates a system in bulk. The trade network is built from the
+		// initial markets by the first tick.
+		explicit SolarSystem(const SystemParameters& params);
+		~SolarSystem();
+		SolarSystem(const SolarSystem&) = delete;
+		SolarSystem(const SolarSystem&&) = delete;
+		SolarSystem& operator=(const SolarSystem&) & = delete;
+		SolarSystem& operator=(SolarSystem&&) & = delete;
+
+		const std::vector<SolarObject*>& getObjects() const;
+		void update(float time);
+		void updateSettlements();
+		// The econ tick in stages, see EconStage. beginTick() updates the
+		// prices of all markets and stepTick() then updates the due
+		// settlements in arena order until the deadline has passed,
+		// followed by colonisation. Each step does at least one unit of
+		// work; returns true once the settlements are done. endTick()
+		// removes the settlements abandoned in the tick and records the
+		// markets for the next trade network, so it must run after
+		// everything else that trades in the tick.
+		//
+		// stepTradeNetwork() builds the routes from the markets of the
+		// last endTick(), one source market per unit of work, and may run
+		// on another thread while beginTick() and stepTick() run. Returns
+		// true once the network is built.
+		//
+		// updateSettlements() runs all of it in order, so its routes are
+		// those of the tick just run.
+		//
+		// The steps split one tick rather than giving each settlement a
+		// phase of its own: with phases a settlement would trade at prices
+		// of a different update than in the batch tick, which changes the
+		// results. Stepping with any budget gives the batch result as long
+		// as nothing else trades in between.
+		void beginTick();
+		bool stepTick(std::chrono::steady_clock::time_point deadline);
+		void endTick();
+		bool isTicking() const { return mTicking; }
+		bool stepTradeNetwork(std::chrono::steady_clock::time_point deadline);
+		EconTimeline& getTimeline() { return mTimeline; }
+		const EconTimeline& getTimeline() const { return mTimeline; }
+
+		// The snapshot of the economy for readers on the main thread, see
+		// EconSnapshot. takeSnapshot() fills the back buffer, which is
+		// made the front by publishSnapshot(). Null before the first
+		// snapshot is published.
+		const EconSnapshot* getSnapshot() const;
+		void takeSnapshot();
+		void publishSnapshot();
+		// see Market; traders landing still trade directly
+		void setCallAuction(bool b) { mSettlements.setCallAuction(b); }
+		SettlementArena& getSettlements() { return mSettlements; }
+		const SettlementArena& getSettlements() const { return mSettlements; }
+		TradeNetwork& getTradeNetwork() { return mTradeNetwork; }
+		const TradeNetwork& getTradeNetwork() const { return mTradeNetwork; }
+
+		// While the system is not observed its traders are simulated
+		// as one aggregate fleet that pools their money and cargo.
+		unsigned int getFleetSize() const { return mFleetSize; }
+		void setFleetSize(unsigned int num) { mFleetSize = num; }
+		Trader& getFleetTrader() { return mFleet; }
+		const Trader& getFleetTrader() const { return mFleet; }
+		void updateFleetTrade();
+
+		// trade of the aggregate fleet with other systems
+		void getPriceRanges(std::map<std::string, PriceRange>& ranges) const;
+		unsigned int exportGoods(const std::string& product, unsigned int num);
+		void importGoods(const std::string& product, unsigned int num);
+
+		// Paging of the economic state (settlements and fleet). The solar
+		// objects themselves stay in memory.
+		void saveState(StateWriter& w) const;
+		void evictState();
+		void loadState(StateReader& r);
+		bool isResident() const { return mResident; }
+
+	private:
+		void updateTradeNetwork();
+		void recordTradeInputs();
+		void updateTradeRoutesFrom(unsigned int source);
+		void foundNewSettlement(SolarObject* from);
+		void abandonSettlement(unsigned int i);
+
+		// scratch buffers kept between ticks to avoid allocations
+		std::vector<std::pair<ProductId, float>> mOffers;
+		std::vector<TradeRoute*> mFleetRoutes;
+
+		SettlementArena mSettlements;
+		std::vector<SolarObject*> mObjects;
+		TradeNetwork mTradeNetwork;
+		unsigned int mFleetSize = 0;
+		Trader mFleet;
+		bool mResident = true;
+
+		// progress of the current tick
+		bool mTicking = false;
+		unsigned int mTickSettlementPos = 0;
+		// settlements that want to found a new one
+		std::vector<unsigned int> mColonising;
+		// with too few people, see Settlement::isAbandoned()
+		std::vector<unsigned int> mAbandoning;
+		EconTimeline mTimeline;
+
+		// The read set of the trade network stage: the markets as of the
+		// last endTick(), with the prices and stock of market i at
+		// i * NumProducts. mRoutePos is the next source to build.
+		std::vector<SolarObject*> mRouteMarkets;
+		std::vector<Money> mRouteMoney;
+		std::vector<float> mRoutePrices;
+		std::vector<unsigned char> mRouteStocked;
+		unsigned int mRoutePos = 0;
+
+		// created by the first takeSnapshot()
+		EconSnapshot* mSnapshots[2] = { nullptr, nullptr };
+		std::atomic<int> mFrontSnapshot{-1};
+
+		// generated systems keep all objects in a single block
+		SolarObject* mObjectBlock = nullptr;
+		unsigned int mNumBlockObjects = 0;
+};
+
+#endif
+
@@ -0,0 +1,54 @@
+#include <cassert>
+#include <cstring>
+
+#include "StateBuffer.h"
+
+StateWriter::StateWriter(bool countOnly)
+	: mCountOnly(countOnly)
+{
+}
+
+void StateWriter::write(const void* data, size_t len)
+{
+	if(!mCountOnly) {
+		auto p = static_cast<const char*>(data);
+		mBuffer.insert(mBuffer.end(), p, p + len);
+	}
+	mSize += len;
+}
+
+void StateWriter::write(const std::string& s)
+{
+	unsigned int len = s.size();
+	write(len);
+	write(s.data(), len);
+}
+
+void StateWriter::clear()
+{
+	mBuffer.clear();
+	mSize = 0;
+}
+
+StateReader::StateReader(const char* data, size_t len)
+	: mData(data),
+	mLen(len)
+{
+}
+
+void StateReader::read(void* data, size_t len)
+{
+	assert(mPos + len <= mLen);
+	memcpy(data, mData + mPos, len);
+	mPos += len;
+}
+
+void StateReader::read(std::string& s)
+{
+	unsigned int len;
+	read(len);
+	assert(mPos + len <= mLen);
+	s.assign(mData + mPos, len);
+	mPos += len;
+}
+
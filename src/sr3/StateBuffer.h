@@ -0,0 +1,40 @@
+#ifndef SR3_STATEBUFFER_H
+#define SR3_STATEBUFFER_H
+
+#include <string>
+#include <vector>
+
+// Flat binary encoding of simulation state, used for paging out systems.
+// A writer created with countOnly only counts the bytes it would write.
+class StateWriter {
+	public:
+		StateWriter(bool countOnly = false);
+		void write(const void* data, size_t len);
+		void write(const std::string& s);
+		template<typename T> void write(const T& v) { write(&v, sizeof(T)); }
+		size_t size() const { return mSize; }
+		const char* data() const { return mBuffer.data(); }
+		void clear();
+
+	private:
+		bool mCountOnly;
+		size_t mSize = 0;
+		std::vector<char> mBuffer;
+};
+
+class StateReader {
+	public:
+		StateReader(const char* data, size_t len);
+		void read(void* data, size_t len);
+		void read(std::string& s);
+		template<typename T> void read(T& v) { read(&v, sizeof(T)); }
+		bool atEnd() const { return mPos == mLen; }
+
+	private:
+		const char* mData;
+		size_t mLen;
+		size_t mPos = 0;
+};
+
+#endif
+
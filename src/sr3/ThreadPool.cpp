@@ -0,0 +1,102 @@
+#include <cassert>
+
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned int numThreads)
+{
+	if(numThreads < 1)
+		numThreads = 1;
+	for(unsigned int i = 0; i < numThreads; i++)
+		mQueues.push_back(new Queue());
+	// queue 0 belongs to the calling thread
+	for(unsigned int i = 1; i < numThreads; i++)
+		mThreads.push_back(std::thread(&ThreadPool::work, this, i));
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mQuit = true;
+	}
+	mWake.notify_all();
+	for(auto& t : mThreads)
+		t.join();
+	for(auto q : mQueues)
+		delete q;
+}
+
+void ThreadPool::run(const std::vector<std::function<void ()>>& tasks)
+{
+	if(tasks.empty())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		assert(mPending == 0);
+		mPending = tasks.size();
+		for(unsigned int i = 0; i < tasks.size(); i++) {
+			auto q = mQueues[i % mQueues.size()];
+			std::lock_guard<std::mutex> qlock(q->Mutex);
+			q->Tasks.push_back(&tasks[i]);
+		}
+		mGeneration++;
+	}
+	mWake.notify_all();
+
+	while(runTask(0))
+		;
+
+	std::unique_lock<std::mutex> lock(mMutex);
+	mDone.wait(lock, [this] { return mPending == 0; });
+}
+
+void ThreadPool::work(unsigned int id)
+{
+	unsigned int generation = 0;
+	while(1) {
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWake.wait(lock, [this, generation] { return mQuit || mGeneration != generation; });
+			if(mQuit)
+				return;
+			generation = mGeneration;
+		}
+
+		while(runTask(id))
+			;
+	}
+}
+
+bool ThreadPool::runTask(unsigned int id)
+{
+	const std::function<void ()>* task = nullptr;
+	{
+		auto q = mQueues[id];
+		std::lock_guard<std::mutex> lock(q->Mutex);
+		if(!q->Tasks.empty()) {
+			task = q->Tasks.back();
+			q->Tasks.pop_back();
+		}
+	}
+
+	for(unsigned int i = 1; !task && i < mQueues.size(); i++) {
+		auto q = mQueues[(id + i) % mQueues.size()];
+		std::lock_guard<std::mutex> lock(q->Mutex);
+		if(!q->Tasks.empty()) {
+			task = q->Tasks.front();
+			q->Tasks.pop_front();
+		}
+	}
+
+	if(!task)
+		return false;
+
+	(*task)();
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	if(--mPending == 0)
+		mDone.notify_all();
+	return true;
+}
+
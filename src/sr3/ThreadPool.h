@@ -0,0 +1,47 @@
+#ifndef SR3_THREADPOOL_H
+#define SR3_THREADPOOL_H
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Work-stealing pool. Each worker pops tasks from the back of its own
+// queue and steals from the front of the other queues once it runs dry.
+// The calling thread works as well while it waits for run() to finish.
+class ThreadPool {
+	public:
+		ThreadPool(unsigned int numThreads);
+		~ThreadPool();
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool(const ThreadPool&&) = delete;
+		ThreadPool& operator=(const ThreadPool&) & = delete;
+		ThreadPool& operator=(ThreadPool&&) & = delete;
+
+		unsigned int getNumThreads() const { return mQueues.size(); }
+		// runs all tasks and returns once they are all finished
+		void run(const std::vector<std::function<void ()>>& tasks);
+
+	private:
+		struct Queue {
+			std::mutex Mutex;
+			std::deque<const std::function<void ()>*> Tasks;
+		};
+
+		void work(unsigned int id);
+		bool runTask(unsigned int id);
+
+		std::vector<Queue*> mQueues;
+		std::vector<std::thread> mThreads;
+		std::mutex mMutex;
+		std::condition_variable mWake;
+		std::condition_variable mDone;
+		unsigned int mPending = 0;
+		unsigned int mGeneration = 0;
+		bool mQuit = false;
+};
+
+#endif
+
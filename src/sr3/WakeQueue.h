@@ -0,0 +1,58 @@
+#ifndef SR3_WAKEQUEUE_H
+#define SR3_WAKEQUEUE_H
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cassert>
+
+// Wake-up times of a set of objects, addressed by handle, earliest
+// first. Wake-ups at the same time come out in the order they were
+// scheduled. An object should have at most one pending wake-up; the
+// handles of objects removed meanwhile are still returned by pop() and
+// are for the caller to skip.
+template<typename H>
+class WakeQueue {
+	public:
+		void schedule(H h, double time)
+		{
+			mHeap.push_back(Entry{time, mNextSeq++, h});
+			std::push_heap(mHeap.begin(), mHeap.end(), Later());
+		}
+
+		// whether the earliest wake-up is at or before the given time
+		bool isDue(double now) const { return !mHeap.empty() && mHeap.front().Time <= now; }
+
+		H pop()
+		{
+			assert(!mHeap.empty());
+			std::pop_heap(mHeap.begin(), mHeap.end(), Later());
+			auto h = mHeap.back().Handle;
+			mHeap.pop_back();
+			return h;
+		}
+
+		unsigned int size() const { return mHeap.size(); }
+		void clear() { mHeap.clear(); }
+
+	private:
+		struct Entry {
+			double Time;
+			uint64_t Seq;
+			H Handle;
+		};
+
+		// std::push_heap keeps the greatest first, so order by lateness
+		struct Later {
+			bool operator()(const Entry& a, const Entry& b) const
+			{
+				return a.Time > b.Time || (a.Time == b.Time && a.Seq > b.Seq);
+			}
+		};
+
+		std::vector<Entry> mHeap;
+		uint64_t mNextSeq = 0;
+};
+
+#endif
+
@@ -0,0 +1,94 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "Test.h"
+#include "Product.h"
+
+#ifndef SR3_STATIC_CATALOG
+// The catalog is a singleton, so each load runs in a child process,
+// which reports the number of products and the total staple consumption.
+static std::string loadCatalog()
+{
+	int fds[2];
+	if(pipe(fds))
+		return std::string();
+	fflush(stdout);
+	fflush(stderr);
+	auto pid = fork();
+	if(pid == 0) {
+		auto catalog = ProductCatalog::getInstance();
+		float consumption = 0.0f;
+		for(unsigned int i = 0; i < NumSOTypes; i++)
+			consumption += catalog->getConsumption(catalog->getStapleId(), SOType(i));
+		char buf[64];
+		int len = snprintf(buf, sizeof(buf), "%u %g", catalog->getNumProducts(), consumption);
+		_exit(write(fds[1], buf, len) == len ? 0 : 1);
+	}
+	close(fds[1]);
+	std::string result;
+	char buf[64];
+	ssize_t len;
+	while((len = read(fds[0], buf, sizeof(buf))) > 0)
+		result.append(buf, len);
+	close(fds[0]);
+	int status;
+	if(pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status))
+		return std::string();
+	return result;
+}
+
+static void replaceInFile(const std::string& path, const std::string& from, const std::string& to)
+{
+	std::stringstream ss;
+	ss << std::ifstream(path).rdbuf();
+	auto s = ss.str();
+	auto pos = s.find(from);
+	CHECK(pos != std::string::npos);
+	if(pos != std::string::npos)
+		s.replace(pos, from.size(), to);
+	std::ofstream(path) << s;
+}
+
+// The cache is rebuilt when products.txt changes, also by an edit that
+// keeps its size, and reused otherwise.
+TEST(catalog_cache_rebuilt)
+{
+	char dir[] = "/tmp/sr3testXXXXXX";
+	CHECK(mkdtemp(dir));
+	std::string base = dir;
+	CHECK(mkdir((base + "/share").c_str(), 0700) == 0);
+	std::ofstream(base + "/share/products.txt") << std::ifstream("share/products.txt").rdbuf();
+	setenv("XDG_CACHE_HOME", (base + "/cache").c_str(), 1);
+	CHECK(chdir(dir) == 0);
+
+	auto first = loadCatalog();
+	CHECK(!first.empty());
+	struct stat st;
+	CHECK(stat("cache/starrover3/products.cache", &st) == 0);
+	CHECK(loadCatalog() == first);
+
+	std::ofstream("share/products.txt", std::ios::app) << "product \"Test goods\" 0.0 0.1 -1 1000\n";
+	auto added = loadCatalog();
+	CHECK(!added.empty() && added != first);
+	CHECK(loadCatalog() == added);
+
+	replaceInFile("share/products.txt", "\"Fruit\"           0.1", "\"Fruit\"           0.2");
+	auto edited = loadCatalog();
+	CHECK(!edited.empty() && edited != added);
+	CHECK(loadCatalog() == edited);
+
+	unlink("cache/starrover3/products.cache");
+	rmdir("cache/starrover3");
+	rmdir("cache");
+	unlink("share/products.txt");
+	rmdir("share");
+	rmdir(dir);
+}
+#endif
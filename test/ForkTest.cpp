@@ -0,0 +1,47 @@
+#include <cstring>
+
+#include "Test.h"
+#include "SolarSystem.h"
+#include "SolarObject.h"
+#include "EconFork.h"
+#include "Product.h"
+#include "StateBuffer.h"
+
+static bool sameState(const StateWriter& a, const StateWriter& b)
+{
+	return a.size() == b.size() && !memcmp(a.data(), b.data(), a.size());
+}
+
+// Trading and ticking on a fork leaves the live economy and its random
+// numbers as they were.
+TEST(fork_keeps_base)
+{
+	Econ::RandomStream random(5);
+	Econ::RandomRedirect redirect(&random);
+	SolarSystem sys;
+	for(int i = 0; i < 20; i++)
+		sys.updateSettlements();
+	StateWriter before;
+	sys.saveState(before);
+	Econ::RandomStream expected(random);
+
+	{
+		auto catalog = ProductCatalog::getInstance();
+		const auto& staple = catalog->getName(catalog->getStapleId());
+		Econ::Fork fork(sys.getObjects());
+		Trader trader(Money::credits(100000), 0);
+		for(auto obj : sys.getObjects()) {
+			if(!obj->hasSettlement())
+				continue;
+			auto num = fork.buy(obj, staple, 100, trader);
+			fork.sell(obj, staple, num, trader);
+		}
+		fork.update(5);
+		CHECK(fork.getNumCopied() > 0);
+	}
+
+	StateWriter after;
+	sys.saveState(after);
+	CHECK(sameState(before, after));
+	CHECK(Econ::uniform() == expected.uniform());
+}
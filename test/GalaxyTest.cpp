@@ -0,0 +1,30 @@
+#include <cstring>
+
+#include "Test.h"
+#include "Galaxy.h"
+#include "SolarSystem.h"
+#include "StateBuffer.h"
+
+static void runGalaxy(unsigned int numThreads, std::vector<StateWriter>& states)
+{
+	Galaxy g(8, numThreads);
+	for(int i = 0; i < 30; i++)
+		g.updateSettlements();
+	states.resize(g.getNumSystems());
+	for(unsigned int i = 0; i < g.getNumSystems(); i++)
+		g.getSystem(i).saveState(states[i]);
+}
+
+// The shards only exchange goods at the barrier, so the number of
+// threads does not change the result.
+TEST(threads_same_result)
+{
+	std::vector<StateWriter> one, many;
+	runGalaxy(1, one);
+	runGalaxy(4, many);
+	CHECK(one.size() == many.size());
+	for(unsigned int i = 0; i < one.size() && i < many.size(); i++) {
+		CHECK(one[i].size() == many[i].size());
+		CHECK(one[i].size() == many[i].size() && !memcmp(one[i].data(), many[i].data(), one[i].size()));
+	}
+}
@@ -0,0 +1,67 @@
+#include <cstring>
+#include <vector>
+
+#include "Test.h"
+#include "SolarSystem.h"
+#include "SolarObject.h"
+#include "Settlement.h"
+#include "StateBuffer.h"
+#include "Econ.h"
+
+struct Schedule {
+	bool Asleep;
+	unsigned int Elapsed;
+};
+
+static std::vector<Schedule> getSchedules(const SolarSystem& sys)
+{
+	std::vector<Schedule> schedules;
+	const auto& arena = sys.getSettlements();
+	for(auto obj : sys.getObjects()) {
+		auto i = obj->getSettlementIndex();
+		if(i != SettlementArena::None)
+			schedules.push_back(Schedule{arena.isAsleep(i), arena.getElapsed(i)});
+	}
+	return schedules;
+}
+
+// Paging a system out and in again keeps its sleeping settlements asleep
+// and the schedule of the others.
+TEST(sleep_state_saved)
+{
+	Econ::RandomStream random(5);
+	Econ::RandomRedirect redirect(&random);
+	SolarSystem sys;
+	for(int i = 0; i < 10; i++)
+		sys.updateSettlements();
+	auto& arena = sys.getSettlements();
+	unsigned int asleep = SettlementArena::None;
+	for(unsigned int i = 0; i < arena.size() && asleep == SettlementArena::None; i++) {
+		if(arena.isLive(i))
+			asleep = i;
+	}
+	CHECK(asleep != SettlementArena::None);
+	if(asleep == SettlementArena::None)
+		return;
+	arena.sleep(asleep);
+	auto obj = arena.getObject(asleep);
+	auto before = getSchedules(sys);
+
+	StateWriter w;
+	sys.saveState(w);
+	sys.evictState();
+	StateReader r(w.data(), w.size());
+	sys.loadState(r);
+
+	CHECK(obj->getSettlementIndex() != SettlementArena::None);
+	CHECK(arena.isAsleep(obj->getSettlementIndex()));
+	auto after = getSchedules(sys);
+	CHECK(before.size() == after.size());
+	for(unsigned int i = 0; i < before.size() && i < after.size(); i++) {
+		CHECK(before[i].Asleep == after[i].Asleep);
+		CHECK(before[i].Elapsed == after[i].Elapsed);
+	}
+	StateWriter again;
+	sys.saveState(again);
+	CHECK(w.size() == again.size() && !memcmp(w.data(), again.data(), w.size()));
+}
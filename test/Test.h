@@ -0,0 +1,22 @@
+#ifndef SR3_TEST_H
+#define SR3_TEST_H
+
+// A minimal test harness. Each test registers itself under its name, and
+// the test binary runs the test named on the command line, or all tests.
+// CHECK() reports a failure and carries on with the test.
+typedef void (*TestFunction)();
+
+struct TestCase {
+	TestCase(const char* name, TestFunction f);
+};
+
+void testFailed(const char* file, int line, const char* expr);
+
+#define TEST(name) \
+	static void test_##name(); \
+	static TestCase testCase_##name(#name, test_##name); \
+	static void test_##name()
+
+#define CHECK(e) do { if(!(e)) testFailed(__FILE__, __LINE__, #e); } while(0)
+
+#endif
@@ -0,0 +1,46 @@
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+
+#include "Test.h"
+
+namespace {
+	std::map<std::string, TestFunction>& getTests()
+	{
+		static std::map<std::string, TestFunction> Tests;
+		return Tests;
+	}
+
+	unsigned int Failures = 0;
+}
+
+TestCase::TestCase(const char* name, TestFunction f)
+{
+	getTests()[name] = f;
+}
+
+void testFailed(const char* file, int line, const char* expr)
+{
+	fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expr);
+	Failures++;
+}
+
+int main(int argc, char** argv)
+{
+	const auto& tests = getTests();
+	if(argc > 1) {
+		auto it = tests.find(argv[1]);
+		if(it == tests.end()) {
+			fprintf(stderr, "No test named %s.\n", argv[1]);
+			return 1;
+		}
+		it->second();
+	} else {
+		for(const auto& it : tests) {
+			printf("%s\n", it.first.c_str());
+			it.second();
+		}
+	}
+	return Failures ? 1 : 0;
+}